@@ -0,0 +1,559 @@
+// Microbenchmarks for the core shop operations on synthetic data, so the
+// cost of loading, saving, searching and reporting can be compared release
+// over release.
+//
+//   tip_shop_bench [--quick] [filter]
+//
+// --quick caps each case at 100k rows; a filter runs only the cases whose name
+// contains it. Everything runs inside bench_data/ under
+// the current directory, so real shop data is never touched.
+
+#define TIP_SHOP_NO_MAIN
+#include "../tip_shop_v10.cpp"
+
+#include <filesystem>
+
+const char* const BENCH_PRODUCTS[] = {"Laptop", "Smartphone", "Tablet", "Monitor", "Keyboard", "Router",
+                                      "Office Chair", "Study Table", "Bookshelf", "Headphones", "Speaker",
+                                      "Power Bank"};
+const char* const BENCH_CONDITIONS[] = {"Fully Functional", "Minor Repairs Needed", "Major Repairs Needed"};
+const char* const BENCH_CATEGORIES[] = {"Electronics", "Electronics", "Electronics", "Electronics",
+                                        "Gadgets", "Gadgets", "Furniture", "Furniture", "Furniture",
+                                        "Gadgets", "Gadgets", "Gadgets"};
+const size_t BENCH_PRODUCT_COUNT = sizeof(BENCH_PRODUCTS) / sizeof(BENCH_PRODUCTS[0]);
+
+// Discards everything written to it; shop functions report through cout
+struct NullBuffer : streambuf {
+    int overflow(int ch) override { return ch; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+string benchFilter;
+NullBuffer nullBuffer;
+volatile size_t benchSink; // results written here are not optimised away
+
+void resetShop() {
+    inventory.clear();
+    rebuildInventoryIndex();
+    repairRequests.clear();
+    transactions.clear();
+    users.clear();
+    repairQueue.clear();
+    repairsByStatus.clear();
+    technicians.clear();
+    receiptArchive.clear();
+    warrantyLedger.clear();
+    unmapFile(snapshotMapping);
+    transactionHistoryPending = false;
+}
+
+// "Laptop 1234"-style names: a dozen products in many models, so both exact
+// and substring searches have realistic hit counts
+void generateCatalogue(size_t count, mt19937& gen) {
+    uniform_int_distribution<> price(100, 50000);
+    uniform_int_distribution<> stock(0, 40);
+    uniform_int_distribution<> condition(0, 2);
+    inventory.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t product = i % BENCH_PRODUCT_COUNT;
+        inventory.push_back({string(BENCH_PRODUCTS[product]) + " " + to_string(1000 + i / BENCH_PRODUCT_COUNT),
+                             BENCH_CONDITIONS[condition(gen)], price(gen), stock(gen),
+                             BENCH_CATEGORIES[product], {}, 0});
+    }
+    rebuildInventoryIndex();
+}
+
+// Sales over the last year, skewed so a few items sell far more than the rest
+void generateSales(size_t count, mt19937& gen) {
+    geometric_distribution<> pick(4.0 / max<size_t>(inventory.size(), 1));
+    uniform_int_distribution<int64_t> age(0, 365 * 86400);
+    time_t now = time(nullptr);
+    transactions.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const Item& item = inventory[pick(gen) % inventory.size()];
+        transactions.append({item.name, item.price, now - static_cast<time_t>(age(gen))});
+    }
+}
+
+void generateUsers(size_t count, size_t technicians, mt19937& gen) {
+    uniform_int_distribution<> expertise(1, 10);
+    for (size_t i = 0; i < count; i++) {
+        string name = "user" + to_string(i);
+        users[name] = {name, "password", i % 3 == 0, static_cast<int>(i % 500), {},
+                       i < technicians ? expertise(gen) : 0};
+    }
+}
+
+void generateRepairQueue(size_t count, mt19937& gen) {
+    uniform_int_distribution<> complexity(1, 10);
+    uniform_int_distribution<> tier(0, TIER_COUNT - 1);
+    for (size_t i = 0; i < count; i++) {
+        recordRepairRequest(BENCH_PRODUCTS[i % BENCH_PRODUCT_COUNT], "Does not power on", complexity(gen), tier(gen));
+    }
+}
+
+// Times `body` `iterations` times after `setup`, which is not timed.
+// Returns the best run in milliseconds, or 0 when filtered out.
+template <typename Setup, typename Body>
+double runCase(const string& name, size_t size, int iterations, Setup setup, Body body) {
+    if (!benchFilter.empty() && name.find(benchFilter) == string::npos) {
+        return 0;
+    }
+    vector<double> runs; // milliseconds
+    streambuf* console = cout.rdbuf(&nullBuffer);
+    for (int i = 0; i < iterations; i++) {
+        setup();
+        auto start = chrono::steady_clock::now();
+        body();
+        runs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        actionArena().reset(); // as the menu does after each action
+    }
+    cout.rdbuf(console);
+
+    sort(runs.begin(), runs.end());
+    cout << left << setw(34) << name << right << setw(10) << size << setw(6) << iterations
+         << fixed << setprecision(3) << setw(14) << runs.front()
+         << setw(14) << runs[runs.size() / 2] << defaultfloat << endl;
+    return runs.front();
+}
+
+void printRate(double bestMs, size_t count, const char* unit) {
+    if (bestMs > 0) {
+        cout << "  " << fixed << setprecision(0) << count / (bestMs / 1000) << " " << unit << "/sec"
+             << defaultfloat << endl;
+    }
+}
+
+void benchSaveLoad(size_t transactionCount) {
+    mt19937 gen(42);
+    auto fill = [&] {
+        resetShop();
+        generateCatalogue(2000, gen);
+        generateSales(transactionCount, gen);
+        generateUsers(1000, 50, gen);
+    };
+    int iterations = transactionCount >= 1000000 ? 3 : 5;
+
+    runCase("saveDataToFile", transactionCount, iterations, fill, [] { saveDataToFile(); });
+    runCase("loadDataFromFile", transactionCount, iterations, [] { resetShop(); }, [] {
+        loadDataFromFile();
+        closeJournal();
+    });
+    runCase("loadDataFromFile+history", transactionCount, iterations, [] { resetShop(); }, [] {
+        loadDataFromFile();
+        ensureTransactionHistoryLoaded();
+        closeJournal();
+    });
+}
+
+void benchSearch(size_t catalogueSize) {
+    mt19937 gen(7);
+    resetShop();
+    generateCatalogue(catalogueSize, gen);
+    size_t hits = 0; // keeps the searches from being optimized away
+    runCase("findMatchingItems(exact)", catalogueSize, 20, [] {}, [&] {
+        hits += findMatchingItems("Laptop 1001").size();
+    });
+    runCase("findMatchingItems(substring)", catalogueSize, 20, [] {}, [&] {
+        hits += findMatchingItems("phone").size();
+    });
+    runCase("findMatchingItems(miss)", catalogueSize, 20, [] {}, [&] {
+        hits += findMatchingItems("typewriter").size();
+    });
+    runCase("findMatchingItems(prefix)", catalogueSize, 20, [] {}, [&] {
+        hits += findMatchingItems("lapt").size();
+    });
+    runCase("findMatchingItems(typo)", catalogueSize, 20, [] {}, [&] {
+        hits += findMatchingItems("labtop 1001").size();
+    });
+    runCase("findMatchingItems(compound)", catalogueSize, 20, [] {}, [&] {
+        hits += findMatchingItems("powerbank").size();
+    });
+    runCase("rebuildInventoryIndex", catalogueSize, 5, [] {}, [] { rebuildInventoryIndex(); });
+    // Search plus the results table, the whole of a search menu action.
+    // After the first run the arena has grown to fit, so the rest should not
+    // touch the heap at all.
+    size_t steadyAllocations = 0;
+    bool warmedUp = false;
+    double best = runCase("search+displayItems", catalogueSize, 10, [] {}, [&] {
+        size_t before = threadAllocations;
+        pmr::vector<int> matches = findMatchingItems("phone");
+        displayItems(matches);
+        hits += matches.size();
+        if (warmedUp) {
+            steadyAllocations += threadAllocations - before;
+        }
+        warmedUp = true;
+    });
+    if (best > 0) {
+        cout << "  heap allocations after warm-up: " << steadyAllocations << endl;
+    }
+    if (hits == SIZE_MAX) {
+        cout << hits << endl;
+    }
+}
+
+// Best sellers recounted from the sales columns on every call, as the
+// popular-items report did before it read the running aggregates; kept as
+// the baseline the aggregates are measured against
+vector<pair<uint32_t, uint32_t>> rescanTopSellers(const TransactionStore& store, size_t count) {
+    vector<uint32_t> counts(store.itemNames.names.size(), 0);
+    const uint32_t* itemIds = store.itemIds.data();
+    for (size_t i = 0; i < store.size(); i++) {
+        counts[itemIds[i]]++;
+    }
+    vector<pair<uint32_t, uint32_t>> ranked;
+    ranked.reserve(counts.size());
+    for (uint32_t id = 0; id < counts.size(); id++) {
+        if (counts[id] > 0) {
+            ranked.push_back({id, counts[id]});
+        }
+    }
+    size_t top = min(count, ranked.size());
+    partial_sort(ranked.begin(), ranked.begin() + top, ranked.end(),
+                 [](const pair<uint32_t, uint32_t>& a, const pair<uint32_t, uint32_t>& b) {
+                     return a.second > b.second;
+                 });
+    ranked.resize(top);
+    return ranked;
+}
+
+void benchPopularItems(size_t transactionCount) {
+    mt19937 gen(11);
+    resetShop();
+    generateCatalogue(5000, gen);
+    runCase("recordSales(aggregates)", transactionCount, 5, [&] { transactions.clear(); }, [&] {
+        generateSales(transactionCount, gen);
+    });
+    if (transactions.empty()) {
+        generateSales(transactionCount, gen); // recordSales was filtered out
+    }
+    size_t ranked = 0;
+    runCase("popularItems(topSellers)", transactionCount, 20, [] {}, [&] {
+        ranked += transactions.stats.topSellers.entries.size();
+    });
+    runCase("popularItems(rescan)", transactionCount, 5, [] {}, [&] {
+        ranked += rescanTopSellers(transactions, TOP_SELLERS_TRACKED).size();
+    });
+    if (ranked == SIZE_MAX) {
+        cout << ranked << endl;
+    }
+}
+
+void benchAssignTechnician(size_t technicianCount) {
+    mt19937 gen(3);
+    const size_t assignments = 1000;
+    auto fill = [&] {
+        resetShop();
+        generateUsers(technicianCount, technicianCount, gen);
+        rebuildTechnicianRegistry();
+        generateRepairQueue(assignments, gen);
+    };
+    runCase("assignRepairTechnician x1000", technicianCount, 5, fill, [&] {
+        for (size_t i = 0; i < assignments; i++) {
+            assignRepairTechnician();
+        }
+    });
+    runCase("assignQueuedRepairs(1000)", technicianCount, 5, fill, [] { assignQueuedRepairs(); });
+}
+
+// Bulk assignment of a morning's backlog: sequential drain against the
+// work-stealing parallel assigner at increasing thread counts
+void benchBulkAssignment(size_t ticketCount) {
+    mt19937 gen(5);
+    auto fill = [&] {
+        resetShop();
+        generateUsers(1000, 1000, gen);
+        rebuildTechnicianRegistry();
+        generateRepairQueue(ticketCount, gen);
+    };
+    runCase("assignQueuedRepairs", ticketCount, 3, fill, [] { assignQueuedRepairs(); });
+    unsigned maxThreads = max(4u, thread::hardware_concurrency());
+    for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        runCase("assignQueuedRepairsParallel(" + to_string(threadCount) + ")", ticketCount, 3, fill,
+                [threadCount] { assignQueuedRepairsParallel(threadCount); });
+    }
+
+    // Both modes must hand out the same technicians. Even expertise levels
+    // only, so odd complexities fall between buckets and exercise the ties.
+    if (!benchFilter.empty() && string("assignQueuedRepairsParallel").find(benchFilter) == string::npos) {
+        return;
+    }
+    auto assignments = [](unsigned threadCount) {
+        mt19937 seeded(7);
+        resetShop();
+        generateUsers(200, 200, seeded);
+        for (auto& entry : users) {
+            entry.second.repairExpertise = (entry.second.repairExpertise + 1) / 2 * 2;
+        }
+        rebuildTechnicianRegistry();
+        generateRepairQueue(20000, seeded);
+        if (threadCount == 0) {
+            assignQueuedRepairs();
+        } else {
+            assignQueuedRepairsParallel(threadCount);
+        }
+        vector<string> assigned;
+        for (const auto& req : repairRequests) {
+            assigned.push_back(req.assignedTechnician);
+        }
+        return assigned;
+    };
+    streambuf* console = cout.rdbuf(&nullBuffer);
+    vector<string> sequential = assignments(0);
+    bool same = sequential == assignments(1) && sequential == assignments(maxThreads);
+    cout.rdbuf(console);
+    cout << "  parallel assignments match assignQueuedRepairs: " << (same ? "yes" : "NO") << endl;
+}
+
+// The stringstream/setw receipt the email build of the shop used, kept here
+// as the baseline for ReceiptTemplate
+string streamReceipt(const Receipt& receipt) {
+    stringstream ss;
+    ss << "+-----------------------------------------+\n";
+    ss << "|    T.I.P. Recycle and Repair Shop       |\n";
+    ss << "|              RECEIPT                    |\n";
+    ss << "+-----------------------------------------+\n";
+    ss << "| Receipt ID: " << setw(28) << receipt.id << " |\n";
+    ss << "| Date: " << setw(35) << ctime(&receipt.timestamp);
+    ss << "+-----------------------------------------+\n";
+    ss << "| Item: " << setw(35) << receipt.itemName << " |\n";
+    ss << "| Condition: " << setw(30) << receipt.condition << " |\n";
+    ss << "| Price: " << setw(34) << receipt.price << " |\n";
+    ss << "| Payment: " << setw(32) << receipt.payment << " |\n";
+    ss << "| Change: " << setw(33) << receipt.change << " |\n";
+    ss << "+-----------------------------------------+\n";
+    ss << "|        Thank you for your purchase!     |\n";
+    ss << "+-----------------------------------------+\n";
+    return ss.str();
+}
+
+// One receipt a second up to now, across 500 customers
+vector<Receipt> generateReceipts(size_t count, mt19937& gen) {
+    uniform_int_distribution<size_t> pick(0, inventory.size() - 1);
+    time_t now = time(nullptr);
+    vector<Receipt> receipts;
+    receipts.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const Item& item = inventory[pick(gen)];
+        receipts.push_back({static_cast<int>(i + 1), "user" + to_string(i % 500), item.name, item.condition,
+                            item.price, item.price + 50, 50, static_cast<int>(i % 5000),
+                            now - static_cast<time_t>(count - i)});
+    }
+    return receipts;
+}
+
+void benchReceipts(size_t receiptCount) {
+    mt19937 gen(7);
+    resetShop();
+    generateCatalogue(1000, gen);
+    vector<Receipt> receipts = generateReceipts(receiptCount, gen);
+
+    size_t checksum = 0;
+    double best = runCase("receipt(stringstream)", receiptCount, 3, [] {}, [&] {
+        for (const Receipt& receipt : receipts) {
+            checksum += streamReceipt(receipt).size();
+        }
+    });
+    printRate(best, receiptCount, "receipts");
+    best = runCase("renderReceipt(string)", receiptCount, 3, [] {}, [&] {
+        for (const Receipt& receipt : receipts) {
+            checksum += renderReceipt(receipt).size();
+        }
+    });
+    printRate(best, receiptCount, "receipts");
+    best = runCase("renderReceipts(arena)", receiptCount, 3, [] {}, [&] {
+        checksum += renderReceipts(receipts.data(), receipts.size(), receiptArena);
+    });
+    printRate(best, receiptCount, "receipts");
+    benchSink = checksum;
+}
+
+void benchReceiptArchive(size_t receiptCount) {
+    mt19937 gen(8);
+    resetShop();
+    generateCatalogue(1000, gen);
+    vector<Receipt> receipts = generateReceipts(receiptCount, gen);
+    runCase("ReceiptArchive::append", receiptCount, 1, [] { receiptArchive.clear(); }, [&] {
+        for (const Receipt& receipt : receipts) {
+            receiptArchive.append(receipt);
+        }
+    });
+    if (receiptArchive.size() != receiptCount) {
+        for (const Receipt& receipt : receipts) { // append was filtered out
+            receiptArchive.append(receipt);
+        }
+    }
+
+    uniform_int_distribution<int> pickId(1, static_cast<int>(receiptCount));
+    Receipt found;
+    size_t checksum = 0;
+    runCase("findReceipt(id) x10000", receiptCount, 5, [] {}, [&] {
+        for (int i = 0; i < 10000; i++) {
+            checksum += findReceipt(pickId(gen), found);
+        }
+    });
+    runCase("ReceiptArchive::open", receiptCount, 5, [] { receiptArchive.close(); }, [] { receiptArchive.open(); });
+    time_t now = time(nullptr);
+    uniform_int_distribution<time_t> pickTime(now - static_cast<time_t>(receiptCount), now);
+    runCase("firstAtOrAfter(time) x1000", receiptCount, 5, [] {}, [&] {
+        for (int i = 0; i < 1000; i++) {
+            checksum += receiptArchive.firstAtOrAfter(pickTime(gen));
+        }
+    });
+    vector<Receipt> page;
+    runCase("page(all) x1000", receiptCount, 5, [] {}, [&] {
+        for (int i = 0; i < 1000; i++) {
+            uint32_t cursor = pickId(gen);
+            checksum += receiptArchive.page("", cursor, RECEIPT_PAGE_SIZE, page);
+        }
+    });
+    runCase("page(customer) x1000", receiptCount, 5, [] {}, [&] {
+        for (int i = 0; i < 1000; i++) {
+            uint32_t cursor = 0;
+            checksum += receiptArchive.page("user" + to_string(i % 500), cursor, RECEIPT_PAGE_SIZE, page);
+        }
+    });
+    benchSink = checksum;
+}
+
+// Checkout with and without a receipt email, against a transport that takes
+// 20 ms per batch; the two should cost the same per sale
+void benchReceiptMail(size_t saleCount) {
+    mt19937 gen(6);
+    auto fill = [&] {
+        resetShop();
+        generateCatalogue(100, gen);
+        for (Item& item : inventory) {
+            item.stock = static_cast<int>(saleCount);
+        }
+        generateUsers(1, 0, gen);
+        LoopbackMailTransport* transport = new LoopbackMailTransport;
+        transport->delayMs = 20;
+        mailQueue.start(unique_ptr<MailTransport>(transport));
+    };
+    auto sell = [saleCount](bool mail) {
+        User& customer = users["user0"];
+        for (size_t i = 0; i < saleCount; i++) {
+            const Item& item = inventory[i % inventory.size()];
+            SaleOutcome sale = sellItem(item.sku, item.price, false, customer);
+            if (mail) {
+                Receipt receipt;
+                findReceipt(sale.receiptId, receipt);
+                queueMail("user0@example.com", "Your T.I.P. Shop receipt", renderReceipt(receipt));
+            }
+        }
+    };
+    runCase("sellItem", saleCount, 5, fill, [&] { sell(false); });
+    runCase("sellItem+queueMail", saleCount, 5, fill, [&] { sell(true); });
+    mailQueue.stop();
+}
+
+// Registrations appended to the ledger, single-serial proofs, and full
+// audits as threads are added
+void benchWarrantyLedger(size_t count) {
+    auto fill = [&] {
+        warrantyLedger.clear();
+        for (size_t i = 0; i < count; i++) {
+            warrantyLedger.append("SN" + to_string(1000000 + i), WARRANTY_DEFAULT_DAYS, 1700000000 + i);
+        }
+    };
+    double best = runCase("warranty append", count, 1, [] {}, fill);
+    printRate(best, count, "registrations");
+    if (warrantyLedger.size() != count) {
+        fill(); // appending was filtered out
+    }
+    mt19937 gen(9);
+    uniform_int_distribution<size_t> pick(0, count - 1);
+    size_t proven = 0;
+    runCase("warranty prove x1000", count, 5, [] {}, [&] {
+        WarrantyProof proof;
+        for (int i = 0; i < 1000; i++) {
+            proven += warrantyLedger.prove("SN" + to_string(1000000 + pick(gen)), proof) && proof.valid;
+        }
+    });
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        best = runCase("warranty audit x" + to_string(threads), count, 3, [] {}, [&] {
+            proven += warrantyLedger.audit(threads).firstBadRecord;
+        });
+        printRate(best, count, "warranties");
+    }
+    benchSink = proven;
+    warrantyLedger.clear();
+}
+
+// A cart of devices through the diagnostics engine on virtual time. Wall
+// time is the engine's own overhead; throughput is per minute of service
+// clock, which is what a real cart would see.
+void benchDiagnostics(size_t devices) {
+    serviceScheduler.clock.virtualTime = true;
+    for (size_t sessions : {1, 4, 16, 64, 256}) {
+        double minutes = 0;
+        double best = runCase("diagnose cart x" + to_string(sessions), devices, 3, [] { resetShop(); }, [&] {
+            DiagnosticsRun run;
+            run.devices.assign(devices, DEVICE_LAPTOP);
+            run.concurrency = sessions;
+            runDiagnostics(run);
+            minutes = (serviceScheduler.clock.nowMs() - run.startMs) / 60000.0;
+        });
+        if (best > 0) {
+            cout << "  " << fixed << setprecision(0) << devices / minutes << " devices/minute" << defaultfloat << endl;
+        }
+    }
+    serviceScheduler.clock.virtualTime = false;
+}
+
+int main(int argc, char* argv[]) {
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        } else {
+            benchFilter = arg;
+        }
+    }
+
+    filesystem::path workDir = filesystem::current_path() / "bench_data";
+    filesystem::create_directories(workDir);
+    filesystem::current_path(workDir);
+    remove(SNAPSHOT_FILE);
+    remove(JOURNAL_FILE);
+
+    cout << left << setw(34) << "Case" << right << setw(10) << "Size" << setw(6) << "Runs"
+         << setw(14) << "Best (ms)" << setw(14) << "Median (ms)" << endl;
+    cout << string(78, '-') << endl;
+
+    for (size_t count : {10000, 100000, 1000000}) {
+        if (quick && count > 100000) {
+            break;
+        }
+        benchSaveLoad(count);
+    }
+    for (size_t count : {1000, 100000, 1000000}) {
+        if (quick && count > 100000) {
+            break;
+        }
+        benchSearch(count);
+    }
+    benchPopularItems(quick ? 100000 : 1000000);
+    for (size_t count : {10, 1000, 100000}) {
+        benchAssignTechnician(count);
+    }
+    benchBulkAssignment(quick ? 100000 : 1000000);
+    benchReceipts(quick ? 100000 : 1000000);
+    for (size_t count : {10000, 1000000}) {
+        if (quick && count > 100000) {
+            break;
+        }
+        benchReceiptArchive(count);
+    }
+    benchReceiptMail(1000);
+    benchDiagnostics(quick ? 1000 : 10000);
+    benchWarrantyLedger(quick ? 100000 : 500000);
+
+    remove(SNAPSHOT_FILE);
+    remove(JOURNAL_FILE);
+    receiptArchive.clear();
+    return 0;
+}
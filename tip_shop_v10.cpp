@@ -13,6 +13,41 @@
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <charconv>
+#include <memory_resource>
+#include <functional>
+#include <array>
+#include <bitset>
+#include <new>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+// unistd.h declares a pause() of its own; keep it clear of ours
+#define pause posix_pause
+#include <unistd.h>
+#undef pause
+#endif
 
 using namespace std;
 
@@ -20,24 +55,223 @@ using namespace std;
 const float STUDENT_DISCOUNT = 0.20;
 const int POINTS_PER_PURCHASE = 10;
 const int REPAIR_QUEUE_SIZE = 5;
+const size_t TOP_SELLERS_TRACKED = 10;
+const size_t STOCK_LOCK_STRIPES = 64;
+const int64_t REPAIR_SECONDS_PER_COMPLEXITY = 3600; // a complexity point waits as long as an hour of age
+const int DEFAULT_REPAIR_COMPLEXITY = 5;
+const char SNAPSHOT_FILE[] = "shop_data.bin";
+const char TEXT_DATA_FILE[] = "shop_data.txt";
+const uint32_t SNAPSHOT_MAGIC = 0x53504954; // "TIPS"
+const uint32_t SNAPSHOT_VERSION = 4;
+const char JOURNAL_FILE[] = "shop_journal.log";
+const size_t JOURNAL_SYNC_RECORDS = 64;           // fsync at least every N records...
+const int JOURNAL_SYNC_INTERVAL_MS = 200;         // ...or when the oldest unsynced one is this old
+const uint64_t JOURNAL_COMPACT_BYTES = 4 << 20;   // fold into a new snapshot past this size
+const char MAIL_OUTBOX_FILE[] = "mail_outbox.txt";
+const size_t MAIL_QUEUE_CAPACITY = 1024;          // power of two
+const size_t MAIL_BATCH_SIZE = 32;
+const int MAIL_MAX_ATTEMPTS = 5;
+const int MAIL_RETRY_BASE_MS = 500;               // doubles after each failed attempt
+const int MAIL_IDLE_WAIT_MS = 1000;
+const char RECEIPT_ARCHIVE_FILE[] = "shop_receipts.dat";
+const char RECEIPT_INDEX_FILE[] = "shop_receipts.idx";
+const size_t RECEIPT_PAGE_SIZE = 10;
+const size_t RECEIPT_DIGEST_CHUNK = 4096;         // receipts read per pass when mailing a day
+const size_t ACTION_ARENA_BYTES = 256 << 10;      // starting scratch block; grows to the largest action
+const size_t SEARCH_PREFIX_TERMS = 64;            // words a search word may expand to as a prefix
+const int SEARCH_EXACT_SCORE = 6;                 // per word, times the field weight
+const int SEARCH_PREFIX_SCORE = 3;                // less one per edit for a near miss
+const int SEARCH_WHOLE_NAME_BONUS = 1 << 20;      // the query is the item's entire name
+const int64_t SERVICE_TICK_MS = 100;              // timer wheel resolution
+const size_t TIMER_WHEEL_SLOTS = 256;             // one turn of the wheel is 25.6 s
+const int64_t DIAGNOSTIC_CONNECT_MS = 3000;       // nominal remote connection time
+const int64_t DIAGNOSTIC_CHECKS_MS = 5000;        // nominal system check time
+const size_t DIAGNOSTIC_MAX_SESSIONS = 256;
+const char WARRANTY_LEDGER_FILE[] = "shop_warranty.dat";
+const char WARRANTY_CHECKPOINT_FILE[] = "shop_warranty.ckp";
+const size_t WARRANTY_CHECKPOINT_RECORDS = 1024;  // records per Merkle checkpoint
+const uint32_t WARRANTY_DEFAULT_DAYS = 365;
+const char OPERATION_STATS_FILE[] = "shop_stats.txt";
+const int OPERATION_STATS_DUMP_SECONDS = 60;      // rewritten at most this often, and on exit
+const char TRACE_FILE[] = "shop_trace.json";
+const size_t TRACE_RING_EVENTS = 4096;            // buffered spans per thread between flushes
 
 // Struct definitions
+// Dictionary encoding for names that repeat across many rows
+struct NameDictionary {
+    vector<string> names;
+    unordered_map<string, uint32_t> ids;
+
+    uint32_t intern(const string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.push_back(name);
+        ids.emplace(name, id);
+        return id;
+    }
+
+    void clear() {
+        names.clear();
+        ids.clear();
+    }
+};
+
+// Shared pool behind InternedString. Entry 0 is the empty string. Strings
+// live in fixed-size chunks that never move, so a reference from str() stays
+// valid. intern() takes a lock (items are added while checkout threads
+// read), but reads do not: an ID only reaches a reader after intern() has
+// stored its text.
+struct InternPool {
+    static const size_t CHUNK_SIZE = 1024;
+    static const size_t MAX_CHUNKS = 4096;
+
+    atomic<string*> chunks[MAX_CHUNKS] = {};
+    unordered_map<string, uint32_t> ids;
+    uint32_t size = 0;
+    mutex lock;
+
+    InternPool() { intern(""); }
+    ~InternPool() {
+        for (atomic<string*>& chunk : chunks) {
+            delete[] chunk.load();
+        }
+    }
+
+    uint32_t intern(const string& text) {
+        lock_guard<mutex> guard(lock);
+        auto it = ids.find(text);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        uint32_t id = size;
+        if (id / CHUNK_SIZE >= MAX_CHUNKS) {
+            throw length_error("too many distinct interned strings");
+        }
+        string* chunk = chunks[id / CHUNK_SIZE].load(memory_order_relaxed);
+        if (!chunk) {
+            chunk = new string[CHUNK_SIZE];
+            chunks[id / CHUNK_SIZE].store(chunk, memory_order_release);
+        }
+        chunk[id % CHUNK_SIZE] = text;
+        ids.emplace(text, id);
+        size++;
+        return id;
+    }
+
+    const string& at(uint32_t id) const {
+        return chunks[id / CHUNK_SIZE].load(memory_order_acquire)[id % CHUNK_SIZE];
+    }
+};
+
+InternPool& internedStrings() {
+    static InternPool pool;
+    return pool;
+}
+
+// A repeated value ("Electronics", "Fully Functional") stored once in the
+// pool. Copies and compares as its 4-byte ID, and converts back to the text
+// wherever a string is expected, so printing works as before.
+struct InternedString {
+    uint32_t id = 0;
+
+    InternedString() {}
+    InternedString(const string& text) : id(internedStrings().intern(text)) {}
+    InternedString(const char* text) : InternedString(string(text)) {}
+
+    const string& str() const { return internedStrings().at(id); }
+    operator const string&() const { return str(); }
+    bool empty() const { return id == 0; }
+    bool operator==(const InternedString& other) const { return id == other.id; }
+    bool operator!=(const InternedString& other) const { return id != other.id; }
+};
+
+ostream& operator<<(ostream& out, const InternedString& value) {
+    return out << value.str();
+}
+
 struct Item {
     string name;
-    string condition;
+    InternedString condition;
     int price;
     int stock;
-    string category;
+    InternedString category;
     vector<string> components;
+    int sku = 0; // stable item ID; menu numbers are only display positions
+    int reserved = 0; // units held by checkouts in progress; never persisted
+};
+
+// Repair tickets covered by a warranty or a repair subscription are
+// scheduled ahead of standard ones
+enum ServiceTier {
+    TIER_STANDARD = 0,
+    TIER_WARRANTY = 1,
+    TIER_SUBSCRIPTION = 2,
+    TIER_COUNT
+};
+
+const char* const TIER_NAMES[TIER_COUNT] = {"Standard", "Warranty", "Subscription"};
+const int64_t TIER_HEAD_START[TIER_COUNT] = {0, 4 * 3600, 8 * 3600};
+
+// Saved and journaled by name, so files keep the same text as before
+enum RepairStatus : uint8_t {
+    REPAIR_PENDING,
+    REPAIR_ASSIGNED,
+    REPAIR_IN_PROGRESS,
+    REPAIR_COMPLETED,
+    REPAIR_STATUS_COUNT
+};
+
+const string REPAIR_STATUS_NAMES[REPAIR_STATUS_COUNT] = {"Pending", "Assigned", "In Progress", "Completed"};
+
+// Allowed moves, [from][to]. Pending tickets wait in the repair queue and
+// only the assigner moves them to Assigned; sending a ticket back to Pending
+// releases its technician, and a completed repair can only be reopened.
+const bool REPAIR_TRANSITIONS[REPAIR_STATUS_COUNT][REPAIR_STATUS_COUNT] = {
+    // Pending  Assigned  In Progress  Completed
+    {false, true, true, false},  // Pending
+    {true, false, true, true},   // Assigned
+    {true, false, false, true},  // In Progress
+    {false, false, true, false}, // Completed
+};
+
+enum PrintStatus : uint8_t {
+    PRINT_QUEUED,
+    PRINT_PRINTING,
+    PRINT_COMPLETED,
+    PRINT_FAILED,
+    PRINT_STATUS_COUNT
+};
+
+const string PRINT_STATUS_NAMES[PRINT_STATUS_COUNT] = {"Queued", "Printing", "Completed", "Failed"};
+
+// Failed jobs can be queued again; completed ones are final
+const bool PRINT_TRANSITIONS[PRINT_STATUS_COUNT][PRINT_STATUS_COUNT] = {
+    // Queued  Printing  Completed  Failed
+    {false, true, false, true},   // Queued
+    {false, false, true, true},   // Printing
+    {false, false, false, false}, // Completed
+    {true, false, false, false},  // Failed
 };
 
+ostream& operator<<(ostream& out, RepairStatus status) {
+    return out << REPAIR_STATUS_NAMES[status];
+}
+
+ostream& operator<<(ostream& out, PrintStatus status) {
+    return out << PRINT_STATUS_NAMES[status];
+}
+
 struct RepairRequest {
     string itemName;
     string issue;
-    string status;
+    RepairStatus status = REPAIR_PENDING;
     time_t submissionTime;
     int complexity;
     string assignedTechnician;
+    int serviceTier = TIER_STANDARD;
 };
 
 struct Transaction {
@@ -46,6 +280,19 @@ struct Transaction {
     time_t timestamp;
 };
 
+// What the customer was handed at checkout; kept in the receipt archive
+struct Receipt {
+    int id;
+    string username;
+    string itemName;
+    string condition;
+    int price;
+    int payment;
+    int change;
+    int loyaltyPoints;  // customer's total after this sale
+    time_t timestamp;
+};
+
 struct User {
     string username;
     string password;
@@ -57,9 +304,48 @@ struct User {
 
 struct PrintJob {
     string modelName;
-    string material;
+    InternedString material;
     int volume;
-    string status;
+    PrintStatus status = PRINT_QUEUED;
+};
+
+// Members of a state machine grouped by state, so counting or listing
+// everything in one state reads a single bucket. Members are indexes into
+// the owning vector; moving one swaps it out of its old bucket in O(1).
+template <size_t STATES>
+struct StatusBuckets {
+    vector<size_t> members[STATES];
+    vector<size_t> slot; // by member: position within its bucket
+
+    void clear() {
+        for (auto& bucket : members) {
+            bucket.clear();
+        }
+        slot.clear();
+    }
+
+    void add(size_t member, int state) {
+        if (member >= slot.size()) {
+            slot.resize(member + 1);
+        }
+        slot[member] = members[state].size();
+        members[state].push_back(member);
+    }
+
+    void move(size_t member, int from, int to) {
+        if (from == to) {
+            return;
+        }
+        vector<size_t>& bucket = members[from];
+        size_t last = bucket.back();
+        bucket[slot[member]] = last;
+        slot[last] = slot[member];
+        bucket.pop_back();
+        add(member, to);
+    }
+
+    size_t count(int state) const { return members[state].size(); }
+    const vector<size_t>& in(int state) const { return members[state]; }
 };
 
 struct RecyclingRecord {
@@ -68,550 +354,6140 @@ struct RecyclingRecord {
     time_t timestamp;
 };
 
-// Global variables
-vector<Item> inventory;
-vector<RepairRequest> repairRequests;
-vector<Transaction> transactions;
-map<string, User> users;
-queue<RepairRequest> repairQueue;
-vector<PrintJob> printJobs;
-vector<RecyclingRecord> recyclingRecords;
+// Binary snapshot layout. The file starts with a SnapshotHeader followed by
+// sections of fixed-width records; every string is stored once in the
+// trailing string pool and referenced by offset/length.
+struct PooledString {
+    uint32_t offset;
+    uint32_t length;
+};
 
-// Function prototypes
-void clearScreen();
-void pause();
-bool verifyStudentID();
-void displayItems(const vector<Item>& items);
-void adminAddNewItem();
-void adminAddStock();
-void buyItem(User& currentUser);
-void submitRepairRequest();
-void viewRepairRequests();
-void updateRepairStatus();
-void displaySalesReport();
-void displayInventoryStatus();
-void displayPopularItems();
-void searchItems();
-void redeemLoyaltyPoints(User& currentUser);
-void saveDataToFile();
-void loadDataFromFile();
-void registerUser();
-User* loginUser();
-void offerTradeIn(User& currentUser);
-void conductVirtualRepairSession();
-void schedulePickupDelivery();
-void displayUserDashboard(const User& user);
-void generateQRCode(const string& data);
-void simulateIoTDeviceRepair();
-void applyAugmentedRealityRepair();
-void offerSubscriptionService();
-void provideRepairEstimate();
-void offerRemoteDiagnostics();
-void gamifyLoyaltyProgram(User& currentUser);
-void displayRepairQueue();
-void assignRepairTechnician();
-void submit3DPrintJob();
-void update3DPrintStatus();
-void displayRecyclingStats();
-void manageInventoryAlerts();
-void implementBlockchainWarranty();
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t count; // number of records (bytes for the string pool)
+};
 
-// Function implementations
-void clearScreen() {
-    #ifdef _WIN32
-        system("cls");
-    #else
-        system("clear");
-    #endif
-}
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    SnapshotSection items;
+    SnapshotSection transactions;
+    SnapshotSection repairs;
+    SnapshotSection users;
+    SnapshotSection strings;
+    uint64_t journalSequence; // last journal record folded into this snapshot (version 2+)
+    SnapshotSection itemStats;  // running sales aggregates (version 4+)
+    SnapshotSection dayStats;
+    SnapshotSection hourStats;
+};
 
-void pause() {
-    cout << "Press Enter to continue...";
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    cin.get();
-}
+const size_t SNAPSHOT_V1_HEADER_SIZE = offsetof(SnapshotHeader, journalSequence);
+const size_t SNAPSHOT_V3_HEADER_SIZE = offsetof(SnapshotHeader, itemStats);
+
+struct ItemRecord {
+    PooledString name;
+    PooledString condition;
+    PooledString category;
+    int32_t price;
+    int32_t stock;
+    int32_t sku; // version 3+
+    int32_t reserved;
+};
 
-bool verifyStudentID() {
-    int studentID;
-    cout << "Enter your 7-digit school ID (starting from 2000000): ";
-    cin >> studentID;
+const size_t ITEM_RECORD_V2_SIZE = offsetof(ItemRecord, sku);
 
-    if (cin.fail()) {
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        cout << "Invalid input. Please enter a number.\n";
-        return false;
-    }
+struct TransactionRecord {
+    PooledString itemName;
+    int64_t timestamp;
+    int32_t price;
+    int32_t reserved;
+};
 
-    if (studentID >= 2000000 && studentID <= 2999999) {
-        cout << "Student ID verified successfully. You are eligible for the student discount.\n";
-        return true;
-    } else {
-        cout << "Invalid ID! You are not eligible for the student discount.\n";
-        return false;
-    }
-}
+struct RepairRecord {
+    PooledString itemName;
+    PooledString issue;
+    PooledString status;
+    PooledString assignedTechnician;
+    int64_t submissionTime;
+    int32_t complexity;
+    int32_t serviceTier; // zero (standard) in snapshots written before it existed
+};
 
-void displayItems(const vector<Item>& items) {
-    cout << setw(5) << "No." << setw(25) << "Name" << setw(25) << "Condition" 
-         << setw(10) << "Price" << setw(10) << "Stock" << setw(15) << "Category" << endl;
-    cout << string(90, '-') << endl;
-    
-    for (size_t i = 0; i < items.size(); i++) {
-        cout << setw(5) << i + 1 
-             << setw(25) << items[i].name 
-             << setw(25) << items[i].condition 
-             << setw(10) << items[i].price 
-             << setw(10) << items[i].stock
-             << setw(15) << items[i].category << endl;
-    }
-}
+struct UserRecord {
+    PooledString username;
+    PooledString password;
+    int32_t isStudent;
+    int32_t loyaltyPoints;
+    int32_t repairExpertise;
+    int32_t reserved;
+};
 
-void adminAddNewItem() {
-    Item newItem;
-    clearScreen();
-    cout << "\n--- Admin: Add New Item ---" << endl;
-    cout << "Enter item name: ";
-    cin.ignore();
-    getline(cin, newItem.name);
-    cout << "Enter item condition: ";
-    getline(cin, newItem.condition);
-    cout << "Enter item price: ";
-    cin >> newItem.price;
-    cout << "Enter initial stock: ";
-    cin >> newItem.stock;
-    cout << "Enter category (Electronics/Furniture/Gadgets): ";
-    cin.ignore();
-    getline(cin, newItem.category);
+struct ItemStatsRecord {
+    PooledString itemName;
+    uint32_t sales;
+    uint32_t reserved;
+    int64_t revenue;
+};
 
-    inventory.push_back(newItem);
-    cout << "New item added successfully!" << endl;
-    pause();
-}
+// One per-day or per-hour bucket; `key` is the local day number or hour
+struct BucketStatsRecord {
+    int64_t key;
+    int64_t revenue;
+    uint32_t sales;
+    uint32_t reserved;
+};
 
-void adminAddStock() {
-    int choice, additionalStock;
-    clearScreen();
-    cout << "\n--- Admin: Add Stock ---" << endl;
-    displayItems(inventory);
-    cout << "Enter the item number to add stock (0 to cancel): ";
-    cin >> choice;
+// Read-only view of a file, memory-mapped where the platform allows it
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    vector<char> buffer;
+};
 
-    if (cin.fail()) {
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        cout << "Invalid input. Please enter a number.\n";
-        pause();
-        return;
+// Write-ahead journal of changes made since the last snapshot
+enum JournalRecordType : uint8_t {
+    JOURNAL_SALE = 1,
+    JOURNAL_STOCK = 2,
+    JOURNAL_NEW_ITEM = 3,
+    JOURNAL_REPAIR_ADDED = 4,
+    JOURNAL_REPAIR_STATUS = 5,
+    JOURNAL_USER_REGISTERED = 6,
+    JOURNAL_LOYALTY_POINTS = 7,
+    JOURNAL_REPAIR_ASSIGNED = 8,
+    JOURNAL_REPAIR_PRIORITY = 9,
+    JOURNAL_TECHNICIAN_EXPERTISE = 10
+};
+
+struct JournalState {
+    mutex lock;
+    int fd = -1;
+    uint64_t nextSequence = 1;
+    uint64_t bytes = 0;
+    size_t unsyncedRecords = 0;
+    // Set once a dropped record has been reported, and while the journal was
+    // never opened or was closed on purpose (opening it reports its own failure)
+    bool reportedClosed = true;
+    chrono::steady_clock::time_point lastSync;
+};
+
+// In-process screen renderer used instead of spawning `clear`. While stdout
+// is a terminal, cout writes through this buffer: clearScreen() starts a new
+// frame at the top of the screen, lines that match the previous frame are
+// skipped, changed ones are overwritten in place, and each flush goes out
+// as a single write.
+struct TerminalRenderer : streambuf {
+    streambuf* target = nullptr;  // cout's own buffer while attached
+    string pending;               // encoded output not yet written
+    string line;                  // current, unfinished line
+    vector<string> previous;      // rows of the last frame known to be on screen
+    vector<string> current;
+    bool tracking = false;        // rows still match `current` one to one
+    size_t rowsUsed = 0;
+    size_t screenRows = 24;
+
+    bool attach() {
+#ifdef _WIN32
+        return false; // clearScreen() keeps using "cls" on Windows consoles
+#else
+        if (target || !isatty(STDOUT_FILENO)) {
+            return target != nullptr;
+        }
+        target = cout.rdbuf(this);
+        return true;
+#endif
     }
 
-    if (choice > 0 && choice <= static_cast<int>(inventory.size())) {
-        cout << "Enter the amount of stock to add: ";
-        cin >> additionalStock;
+    void detach() {
+        if (target) {
+            sync();
+            cout.rdbuf(target);
+            target = nullptr;
+        }
+    }
 
-        if (cin.fail() || additionalStock < 0) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input. Please enter a positive number.\n";
+    void beginFrame() {
+        if (!line.empty()) {
+            endLine();
+        }
+        if (tracking) {
+            pending += "\033[J"; // the old frame was longer than this one
+        }
+        refreshScreenSize();
+        if (rowsUsed + 1 >= screenRows) {
+            // The last frame scrolled, so no row is where we think it is
+            pending += "\033[H\033[2J";
+            previous.clear();
         } else {
-            inventory[choice - 1].stock += additionalStock;
-            cout << "Stock updated. New stock for " << inventory[choice - 1].name << ": " << inventory[choice - 1].stock << endl;
+            pending += "\033[H";
+            previous.swap(current);
         }
-    } else if (choice != 0) {
-        cout << "Invalid choice!" << endl;
+        current.clear();
+        rowsUsed = 0;
+        tracking = true;
+        sync();
     }
-    pause();
-}
-
-void buyItem(User& currentUser) {
-    int choice;
-    clearScreen();
-    cout << "Select an item to buy: " << endl;
-    displayItems(inventory);
-    cout << "Enter your choice (0 to cancel): ";
-    cin >> choice;
 
-    if (cin.fail()) {
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        cout << "Invalid input. Please enter a number.\n";
-        pause();
-        return;
+    void refreshScreenSize() {
+#ifndef _WIN32
+        winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+            screenRows = size.ws_row;
+        }
+#endif
     }
 
-    if (choice > 0 && choice <= static_cast<int>(inventory.size()) && inventory[choice - 1].stock > 0) {
-        int payment;
-        float price = inventory[choice - 1].price;
+    void endLine() {
+        if (tracking && rowsUsed + 1 < screenRows) {
+            size_t row = current.size();
+            if (row < previous.size() && previous[row] == line) {
+                pending += '\n';
+            } else {
+                pending += line;
+                pending += "\033[K\n";
+            }
+            current.push_back(line);
+        } else {
+            tracking = false;
+            pending += line;
+            pending += '\n';
+        }
+        rowsUsed++;
+        line.clear();
+    }
 
-        if (currentUser.isStudent && verifyStudentID()) {
-            price -= price * STUDENT_DISCOUNT;
-            cout << "Discounted Price: P" << price << endl;
+    int overflow(int ch) override {
+        if (ch == traits_type::eof()) {
+            return 0;
+        }
+        if (ch == '\n') {
+            endLine();
         } else {
-            cout << "Total Price: P" << price << endl;
+            line += static_cast<char>(ch);
         }
+        return ch;
+    }
 
-        cout << "Enter payment amount: P";
-        cin >> payment;
+    streamsize xsputn(const char* s, streamsize n) override {
+        const char* end = s + n;
+        while (s < end) {
+            const char* newline = static_cast<const char*>(memchr(s, '\n', end - s));
+            if (!newline) {
+                line.append(s, end);
+                break;
+            }
+            line.append(s, newline);
+            endLine();
+            s = newline + 1;
+        }
+        return n;
+    }
 
-        if (cin.fail()) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input. Please enter a number.\n";
-            pause();
-            return;
+    int sync() override {
+        if (!target) {
+            return 0;
+        }
+        if (!line.empty()) {
+            // A prompt: clear what is left of the old frame below it. The
+            // user's input is echoed by the terminal, not through here, so
+            // rows can no longer be tracked until the next frame.
+            pending += line;
+            if (tracking) {
+                pending += "\033[J";
+                tracking = false;
+            }
+            rowsUsed++;
+            line.clear();
         }
+        target->sputn(pending.data(), pending.size());
+        pending.clear();
+        return target->pubsync();
+    }
+};
 
-        if (payment >= price) {
-            int change = payment - price;
-            cout << "Payment successful. Change: P" << change << endl;
+// Scratch memory for one menu action or batch command. Temporaries such as
+// report tables and search results take memory by bumping an offset in a
+// retained block, and reset() frees all of it at once when the action ends.
+// Anything that did not fit comes from the heap for that action only, and
+// the block then grows to the largest action seen. Repeating an action
+// therefore makes no further heap allocations. Main thread only.
+struct ActionArena : pmr::memory_resource {
+    struct Overflow {
+        Overflow* next;
+        size_t alignment;
+    };
+    vector<char> block;
+    size_t used = 0;
+    size_t overflowBytes = 0;  // this action's requests that missed the block
+    Overflow* overflow = nullptr;
+
+    // Counters since startup
+    size_t allocations = 0;
+    size_t bytesAllocated = 0;
+    size_t heapAllocations = 0;  // requests that fell through to operator new
+    size_t peakBytes = 0;        // largest single action
+    size_t actions = 0;          // resets
+
+    explicit ActionArena(size_t initialBytes) : block(initialBytes) {}
+    ~ActionArena() { release(); }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        allocations++;
+        bytesAllocated += bytes;
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + bytes <= block.size()) {
+            used = start + bytes;
+            return block.data() + start;
+        }
+        heapAllocations++;
+        overflowBytes += bytes + alignment;
+        size_t header = (sizeof(Overflow) + alignment - 1) & ~(alignment - 1);
+        size_t chunkAlignment = max(alignment, alignof(Overflow));
+        char* chunk = static_cast<char*>(::operator new(header + bytes, align_val_t(chunkAlignment)));
+        overflow = new (chunk) Overflow{overflow, chunkAlignment};
+        return chunk + header;
+    }
 
-            inventory[choice - 1].stock--;
+    void do_deallocate(void*, size_t, size_t) override {} // freed by reset()
 
-            transactions.push_back({inventory[choice - 1].name, static_cast<int>(price), time(nullptr)});
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
 
-            currentUser.loyaltyPoints += POINTS_PER_PURCHASE;
-            cout << "You earned " << POINTS_PER_PURCHASE << " loyalty points!" << endl;
+    void release() {
+        while (overflow) {
+            Overflow* next = overflow->next;
+            ::operator delete(overflow, align_val_t(overflow->alignment));
+            overflow = next;
+        }
+    }
 
-            cout << "\n--- Receipt ---" << endl;
-            cout << "Item: " << inventory[choice - 1].name << endl;
-            cout << "Condition: " << inventory[choice - 1].condition << endl;
-            cout << "Price: P" << price << endl;
-            cout << "Payment: P" << payment << endl;
-            cout << "Change: P" << change << endl;
-            cout << "Loyalty Points Earned: " << POINTS_PER_PURCHASE << endl;
-            cout << "Total Loyalty Points: " << currentUser.loyaltyPoints << endl;
-            cout << "Thank you for your purchase!" << endl;
-            cout << "-----------------\n" << endl;
-        } else {
-            cout << "Insufficient payment. Transaction canceled." << endl;
+    // Ends the current action. Nothing allocated from the arena may be used
+    // after this.
+    void reset() {
+        release();
+        size_t needed = used + overflowBytes;
+        peakBytes = max(peakBytes, needed);
+        if (overflowBytes > 0) {
+            vector<char>(needed + needed / 2).swap(block);
         }
-    } else if (choice != 0) {
-        cout << "Invalid choice or out of stock!" << endl;
+        used = 0;
+        overflowBytes = 0;
+        actions++;
     }
-    pause();
+};
+
+ActionArena& actionArena() {
+    static ActionArena arena(ACTION_ARENA_BYTES);
+    return arena;
 }
 
-void submitRepairRequest() {
-    RepairRequest request;
+// Per-operation latency and allocation counts. Building with
+// TIP_SHOP_NO_METRICS compiles the timers and the allocation hook out.
+enum Operation {
+    OP_BUY_ITEM,
+    OP_SELL_ITEM,
+    OP_LOAD_DATA,
+    OP_SAVE_DATA,
+    OP_SEARCH_ITEMS,
+    OP_ASSIGN_TECHNICIAN,
+    OP_SALES_REPORT,
+    OP_INVENTORY_STATUS,
+    OP_POPULAR_ITEMS,
+    OP_RECYCLING_STATS,
+    OPERATION_COUNT
+};
+
+const char* const OPERATION_NAMES[OPERATION_COUNT] = {
+    "buyItem", "sellItem", "loadDataFromFile", "saveDataToFile", "searchItems", "assignNextRepair",
+    "displaySalesReport", "displayInventoryStatus", "displayPopularItems", "displayRecyclingStats"};
+
+// Heap allocations made by this thread, counted by the operator new set below
+thread_local uint64_t threadAllocations = 0;
+
+#ifndef TIP_SHOP_NO_METRICS
+// The whole replaceable set, so every form of new is counted and each block
+// goes back through the matching release. The releases are kept out of
+// line: inlined next to the operator new they pair with, GCC's
+// -Wmismatched-new-delete reads the free() as a mismatch.
+#if defined(__GNUC__)
+#define ALLOCATION_NOINLINE __attribute__((noinline))
+#else
+#define ALLOCATION_NOINLINE
+#endif
+
+void* countedMalloc(size_t size) noexcept {
+    threadAllocations++;
+    return malloc(size ? size : 1);
+}
+
+void* countedAlignedMalloc(size_t size, align_val_t alignment) noexcept {
+    threadAllocations++;
+    size = size ? size : 1;
+#ifdef _WIN32
+    return _aligned_malloc(size, static_cast<size_t>(alignment));
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, max(static_cast<size_t>(alignment), sizeof(void*)), size) == 0 ? p : nullptr;
+#endif
+}
+
+ALLOCATION_NOINLINE void releaseAllocation(void* p) noexcept {
+    free(p);
+}
+
+ALLOCATION_NOINLINE void releaseAlignedAllocation(void* p) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void* operator new(size_t size) {
+    if (void* p = countedMalloc(size)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    if (void* p = countedAlignedMalloc(size, alignment)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, align_val_t alignment) { return operator new(size, alignment); }
+void* operator new(size_t size, const nothrow_t&) noexcept { return countedMalloc(size); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return countedMalloc(size); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return countedAlignedMalloc(size, alignment);
+}
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return countedAlignedMalloc(size, alignment);
+}
+
+void operator delete(void* p) noexcept { releaseAllocation(p); }
+void operator delete[](void* p) noexcept { releaseAllocation(p); }
+void operator delete(void* p, size_t) noexcept { releaseAllocation(p); }
+void operator delete[](void* p, size_t) noexcept { releaseAllocation(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { releaseAllocation(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { releaseAllocation(p); }
+void operator delete(void* p, align_val_t) noexcept { releaseAlignedAllocation(p); }
+void operator delete[](void* p, align_val_t) noexcept { releaseAlignedAllocation(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { releaseAlignedAllocation(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { releaseAlignedAllocation(p); }
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { releaseAlignedAllocation(p); }
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { releaseAlignedAllocation(p); }
+#endif
+
+// Index of the highest set bit of a non-zero value (a binary search, since
+// the count-leading-zeros builtins are compiler-specific)
+int highestBit(uint64_t value) {
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+// Log-linear histogram in the style of HdrHistogram. Each power of two is
+// split into SUB_BUCKETS equal steps, so a recorded value is off by at most
+// 1/SUB_BUCKETS. Recording is a few relaxed atomic adds, so checkout
+// threads can share it.
+struct LatencyHistogram {
+    static const int SUB_BITS = 4;
+    static const size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+    static const int MAX_BITS = 41; // about 36 minutes in nanoseconds
+    static const size_t BUCKETS = SUB_BUCKETS * (MAX_BITS - SUB_BITS + 1);
+
+    atomic<uint64_t> buckets[BUCKETS] = {};
+    atomic<uint64_t> count{0};
+    atomic<uint64_t> totalNs{0};
+    atomic<uint64_t> maxNs{0};
+    atomic<uint64_t> allocations{0};
+
+    static size_t bucketOf(uint64_t ns) {
+        ns = min<uint64_t>(ns, (uint64_t(1) << MAX_BITS) - 1);
+        if (ns < SUB_BUCKETS) {
+            return static_cast<size_t>(ns);
+        }
+        int shift = highestBit(ns) - SUB_BITS;
+        return SUB_BUCKETS * (shift + 1) + static_cast<size_t>((ns >> shift) - SUB_BUCKETS);
+    }
+
+    // Largest value that lands in `bucket`
+    static uint64_t upperBound(size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+        uint64_t lowest = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        return lowest + (uint64_t(1) << shift) - 1;
+    }
+
+    void record(uint64_t ns, uint64_t allocationCount) {
+        buckets[bucketOf(ns)].fetch_add(1, memory_order_relaxed);
+        count.fetch_add(1, memory_order_relaxed);
+        totalNs.fetch_add(ns, memory_order_relaxed);
+        allocations.fetch_add(allocationCount, memory_order_relaxed);
+        uint64_t seen = maxNs.load(memory_order_relaxed);
+        while (ns > seen && !maxNs.compare_exchange_weak(seen, ns, memory_order_relaxed)) {
+        }
+    }
+
+    // Value at or below which `fraction` of the samples fall
+    uint64_t percentile(double fraction) const {
+        uint64_t total = count.load(memory_order_relaxed);
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(fraction * total)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += buckets[i].load(memory_order_relaxed);
+            if (seen >= rank) {
+                return min(upperBound(i), maxNs.load(memory_order_relaxed));
+            }
+        }
+        return maxNs.load(memory_order_relaxed);
+    }
+};
+
+LatencyHistogram operationStats[OPERATION_COUNT];
+
+// Nanoseconds this thread has spent in InputWait scopes. Timers subtract
+// what accrued while they ran, the way they count allocations, so nested
+// timers need no links between them.
+thread_local uint64_t threadInputWaitNs = 0;
+
+// Times the rest of the scope, or up to stop(), as one `op`, less any
+// InputWait inside it
+struct OperationTimer {
+    Operation op;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t allocationsAtStart = threadAllocations;
+    uint64_t waitedAtStart = threadInputWaitNs;
+    bool running = true;
+
+    explicit OperationTimer(Operation op) : op(op) {}
+    ~OperationTimer() { stop(); }
+
+    void stop() {
+        if (running) {
+            running = false;
+            auto ns = static_cast<uint64_t>(
+                chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            uint64_t waited = threadInputWaitNs - waitedAtStart;
+            operationStats[op].record(ns - min(waited, ns), threadAllocations - allocationsAtStart);
+        }
+    }
+};
+
+// Time spent waiting on the user mid-operation (the table pager), taken off
+// every running timer
+struct InputWait {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    ~InputWait() {
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        threadInputWaitNs += static_cast<uint64_t>(ns);
+    }
+};
+
+// END_OPERATION() stops the timer before a screen waits for Enter, and
+// WAITING_FOR_INPUT() excludes the rest of its scope from running timers,
+// so the customer's reading time is not counted
+#ifndef TIP_SHOP_NO_METRICS
+#define MEASURE_OPERATION(op) OperationTimer operationTimer(op)
+#define END_OPERATION() operationTimer.stop()
+#define WAITING_FOR_INPUT() InputWait inputWait
+#else
+#define MEASURE_OPERATION(op) ((void)0)
+#define END_OPERATION() ((void)0)
+#define WAITING_FOR_INPUT() ((void)0)
+#endif
+
+// Timeline tracing. A TraceSpan records one Chrome trace-event "complete"
+// event when it goes out of scope, into a ring owned by the calling thread:
+// the thread only advances `head` and the flusher only advances `tail`, so
+// neither side takes a lock. Spans are skipped while tracing is off, and a
+// full ring drops events rather than blocking the thread that is being
+// traced. Span names must be string literals (or __func__) with no
+// characters that need escaping in JSON.
+struct TraceEvent {
+    const char* name;
+    const char* argName; // optional numeric argument, shown in the viewer
+    int64_t arg;
+    uint64_t startNs;
+    uint64_t durationNs;
+};
+
+struct TraceRing {
+    TraceEvent events[TRACE_RING_EVENTS];
+    atomic<uint64_t> head{0};
+    atomic<uint64_t> tail{0};
+    atomic<uint64_t> dropped{0};
+    atomic<bool> owned{true}; // a ring freed by an exiting thread is reused by the next one
+    uint32_t threadId = 0;
+    bool mainThread = false;
+
+    void push(const TraceEvent& event) {
+        uint64_t h = head.load(memory_order_relaxed);
+        if (h - tail.load(memory_order_acquire) >= TRACE_RING_EVENTS) {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        events[h % TRACE_RING_EVENTS] = event;
+        head.store(h + 1, memory_order_release);
+    }
+};
+
+atomic<bool> tracingEnabled{false};
+
+struct TraceRegistry {
+    mutex lock;
+    vector<unique_ptr<TraceRing>> rings;
+    chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+    thread::id mainThread = this_thread::get_id();
+};
+
+TraceRegistry& traceRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+uint64_t traceNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - traceRegistry().epoch).count();
+}
+
+// Hands the ring back when its thread exits
+struct TraceRingHandle {
+    TraceRing* ring = nullptr;
+    ~TraceRingHandle() {
+        if (ring) {
+            ring->owned.store(false, memory_order_release);
+        }
+    }
+};
+
+TraceRing& threadTraceRing() {
+    thread_local TraceRingHandle handle;
+    if (!handle.ring) {
+        TraceRegistry& registry = traceRegistry();
+        lock_guard<mutex> guard(registry.lock);
+        for (unique_ptr<TraceRing>& ring : registry.rings) {
+            if (!ring->owned.load(memory_order_acquire)) {
+                ring->owned.store(true, memory_order_relaxed);
+                handle.ring = ring.get();
+                break;
+            }
+        }
+        if (!handle.ring) {
+            registry.rings.emplace_back(new TraceRing);
+            handle.ring = registry.rings.back().get();
+            handle.ring->threadId = static_cast<uint32_t>(registry.rings.size());
+            handle.ring->mainThread = this_thread::get_id() == registry.mainThread;
+        }
+    }
+    return *handle.ring;
+}
+
+struct TraceSpan {
+    const char* name;
+    const char* argName;
+    int64_t arg;
+    uint64_t start = 0;
+    bool active;
+
+    explicit TraceSpan(const char* name, const char* argName = nullptr, int64_t arg = 0)
+        : name(name), argName(argName), arg(arg), active(tracingEnabled.load(memory_order_relaxed)) {
+        if (active) {
+            start = traceNow();
+        }
+    }
+
+    ~TraceSpan() { end(); }
+
+    void end() {
+        if (active) {
+            active = false;
+            threadTraceRing().push({name, argName, arg, start, traceNow() - start});
+        }
+    }
+};
+
+// Writes the rings out as a JSON array of trace events. The closing bracket
+// is written when tracing stops; the viewers also load a file without it,
+// so a trace survives a crash up to the last flush.
+struct TraceWriter {
+    mutex lock;
+    ofstream out;
+    size_t eventsWritten = 0;
+    size_t ringsNamed = 0;
+    uint64_t droppedAtStart = 0;
+
+    void writeEvent(const char* text) {
+        out << (eventsWritten++ ? ",\n" : "[\n") << text;
+    }
+
+    // Called with `lock` held
+    void flushLocked() {
+        TraceRegistry& registry = traceRegistry();
+        vector<TraceRing*> rings;
+        {
+            lock_guard<mutex> guard(registry.lock);
+            for (unique_ptr<TraceRing>& ring : registry.rings) {
+                rings.push_back(ring.get());
+            }
+        }
+        char text[256];
+        for (; ringsNamed < rings.size(); ringsNamed++) {
+            const TraceRing& ring = *rings[ringsNamed];
+            snprintf(text, sizeof(text),
+                     "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                     ring.threadId, ring.mainThread ? "main" : "worker", ring.threadId);
+            writeEvent(text);
+        }
+        for (TraceRing* ring : rings) {
+            uint64_t t = ring->tail.load(memory_order_relaxed);
+            uint64_t h = ring->head.load(memory_order_acquire);
+            for (; t < h; t++) {
+                const TraceEvent& event = ring->events[t % TRACE_RING_EVENTS];
+                int length = snprintf(text, sizeof(text),
+                                      "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                                      event.name, ring->threadId, event.startNs / 1000.0, event.durationNs / 1000.0);
+                if (event.argName && length > 0 && length < static_cast<int>(sizeof(text))) {
+                    snprintf(text + length, sizeof(text) - length, ",\"args\":{\"%s\":%lld}", event.argName,
+                             static_cast<long long>(event.arg));
+                }
+                strncat(text, "}", sizeof(text) - strlen(text) - 1);
+                writeEvent(text);
+            }
+            ring->tail.store(h, memory_order_release);
+        }
+        out.flush();
+    }
+
+    uint64_t droppedTotal() {
+        uint64_t total = 0;
+        lock_guard<mutex> guard(traceRegistry().lock);
+        for (unique_ptr<TraceRing>& ring : traceRegistry().rings) {
+            total += ring->dropped.load(memory_order_relaxed);
+        }
+        return total;
+    }
+};
+
+TraceWriter traceWriter;
+
+// Scoped spans; compiled out along with the operation timers.
+// TRACE_NAMED_SPAN / END_TRACE_SPAN close a span before the end of its
+// scope, like MEASURE_OPERATION / END_OPERATION.
+#ifndef TIP_SHOP_NO_METRICS
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(...) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(__VA_ARGS__)
+#define TRACE_FUNCTION() TRACE_SPAN(__func__)
+#define TRACE_NAMED_SPAN(var, ...) TraceSpan var(__VA_ARGS__)
+#define END_TRACE_SPAN(var) var.end()
+#else
+#define TRACE_SPAN(...) ((void)0)
+#define TRACE_FUNCTION() ((void)0)
+#define TRACE_NAMED_SPAN(var, ...) ((void)0)
+#define END_TRACE_SPAN(var) ((void)0)
+#endif
+
+// Right-aligned fixed-width table (the layout setw() gave the old per-row
+// loops) formatted into one buffer and written a screen page at a time.
+// Its buffers live in the action arena.
+struct TableWriter {
+    pmr::vector<size_t> widths{&actionArena()};
+    pmr::string header{&actionArena()};      // column titles and rule, repeated on each page
+    pmr::string body{&actionArena()};
+    pmr::vector<size_t> rowEnds{&actionArena()}; // offset just past each row's newline
+    size_t column = 0;
+    // ctime() runs once per hour of timestamps; minutes and seconds are
+    // filled in from the cached hour
+    time_t cachedHour = -1;
+    pmr::string cachedPrefix{&actionArena()}; // "Www Mmm dd hh:"
+    pmr::string cachedYear{&actionArena()};   // " yyyy"
+
+    TableWriter(initializer_list<pair<const char*, size_t>> columns, size_t expectedRows) {
+        size_t lineWidth = 0;
+        for (const auto& col : columns) {
+            widths.push_back(col.second);
+            lineWidth += col.second;
+        }
+        for (const auto& col : columns) {
+            cell(col.first);
+        }
+        body += '\n';
+        body.append(lineWidth, '-');
+        body += '\n';
+        header.swap(body);
+        column = 0;
+        body.reserve(expectedRows * (lineWidth + 1));
+        rowEnds.reserve(expectedRows);
+    }
+
+    // Writes the padding for a value of `length` characters in the next column
+    void padTo(size_t length) {
+        if (length < widths[column]) {
+            body.append(widths[column] - length, ' ');
+        }
+        column++;
+    }
+
+    void cell(const string& text) {
+        padTo(text.size());
+        body += text;
+    }
+
+    void cell(long long value) {
+        char text[24];
+        int length = snprintf(text, sizeof(text), "%lld", value);
+        padTo(length);
+        body.append(text, length);
+    }
+
+    void timestampCell(time_t timestamp) {
+        if (cachedHour < 0 || timestamp < cachedHour || timestamp >= cachedHour + 3600) {
+            const char* text = ctime(&timestamp); // "Www Mmm dd hh:mm:ss yyyy\n"
+            if (!text || strlen(text) < 24) {
+                cell("");
+                return;
+            }
+            cachedPrefix.assign(text, 14);
+            cachedYear.assign(text + 19, strlen(text) - 20);
+            cachedHour = timestamp - atoi(text + 14) * 60 - atoi(text + 17);
+        }
+        int offset = static_cast<int>(timestamp - cachedHour);
+        char minutes[5] = {char('0' + offset / 600), char('0' + offset / 60 % 10), ':',
+                           char('0' + offset % 60 / 10), char('0' + offset % 10)};
+        padTo(cachedPrefix.size() + 5 + cachedYear.size());
+        body += cachedPrefix;
+        body.append(minutes, 5);
+        body += cachedYear;
+    }
+
+    void endRow() {
+        body += '\n';
+        rowEnds.push_back(body.size());
+        column = 0;
+    }
+
+    void print();
+};
+
+enum ItemCategory {
+    CATEGORY_ELECTRONICS,
+    CATEGORY_FURNITURE,
+    CATEGORY_GADGETS,
+    CATEGORY_OTHER,
+    CATEGORY_COUNT
+};
+
+const char* const CATEGORY_NAMES[CATEGORY_COUNT] = {"Electronics", "Furniture", "Gadgets", "Other"};
+
+size_t hashKey(int key) {
+    uint64_t x = static_cast<uint64_t>(key) + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return static_cast<size_t>(x ^ (x >> 31));
+}
+
+size_t hashKey(string_view key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+}
+
+// Open-addressing hash table with linear probing, mapping a key to an
+// inventory position. Items are never removed, so there are no tombstones.
+template <typename Key>
+struct OpenAddressIndex {
+    struct Slot {
+        Key key;
+        int position = -1;
+    };
+    vector<Slot> slots;
+    size_t count = 0;
+
+    void clear() {
+        slots.assign(16, Slot());
+        count = 0;
+    }
+
+    // Returns the existing position for the key, or stores and returns `position`
+    int insert(const Key& key, int position) {
+        if (slots.empty() || (count + 1) * 4 > slots.size() * 3) {
+            grow();
+        }
+        size_t mask = slots.size() - 1;
+        size_t i = hashKey(key) & mask;
+        while (slots[i].position >= 0) {
+            if (slots[i].key == key) {
+                return slots[i].position;
+            }
+            i = (i + 1) & mask;
+        }
+        slots[i].key = key;
+        slots[i].position = position;
+        count++;
+        return position;
+    }
+
+    // Stores `position` for the key, replacing any earlier one
+    void assign(const Key& key, int position) {
+        if (insert(key, position) != position) {
+            size_t mask = slots.size() - 1;
+            size_t i = hashKey(key) & mask;
+            while (!(slots[i].key == key)) {
+                i = (i + 1) & mask;
+            }
+            slots[i].position = position;
+        }
+    }
+
+    template <typename Lookup>
+    int find(const Lookup& key) const {
+        if (slots.empty()) {
+            return -1;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t i = hashKey(key) & mask; slots[i].position >= 0; i = (i + 1) & mask) {
+            if (slots[i].key == key) {
+                return slots[i].position;
+            }
+        }
+        return -1;
+    }
+
+    void grow() {
+        vector<Slot> old;
+        old.swap(slots);
+        slots.assign(max<size_t>(16, old.size() * 2), Slot());
+        count = 0;
+        for (auto& slot : old) {
+            if (slot.position >= 0) {
+                insert(slot.key, slot.position);
+            }
+        }
+    }
+};
+
+// Which part of an item a search word was found in
+enum SearchField : uint8_t {
+    FIELD_NAME = 1,
+    FIELD_COMPONENT = 2,
+    FIELD_CATEGORY = 4,
+    FIELD_CONDITION = 8
+};
+
+// A word in the name counts for more than one in the condition or category
+int searchFieldWeight(uint8_t fields) {
+    return fields & FIELD_NAME ? 4 : fields & FIELD_COMPONENT ? 2 : 1;
+}
+
+// Calls visit(token) for each run of letters and digits in `text`,
+// lowercased, so "Wireless  Headphones" and "wireless-headphones" give the
+// same words. `token` is the caller's buffer.
+template <typename Token, typename Visit>
+void forEachSearchToken(string_view text, Token& token, Visit visit) {
+    token.clear();
+    for (size_t i = 0; i <= text.size(); i++) {
+        unsigned char c = i < text.size() ? text[i] : ' ';
+        if (isalnum(c)) {
+            token += static_cast<char>(tolower(c));
+        } else if (!token.empty()) {
+            visit(token);
+            token.clear();
+        }
+    }
+}
+
+bool hasDigit(string_view token) {
+    return any_of(token.begin(), token.end(), [](unsigned char c) { return isdigit(c); });
+}
+
+// Inverted index from search words to the items containing them. A trie
+// over the distinct words answers prefix lookups and edit-distance lookups.
+// Items are only ever appended, so each postings list stays in inventory
+// order.
+struct FullTextIndex {
+    struct Posting {
+        int position;
+        uint8_t fields; // SearchField bits
+    };
+    // Children are a linked list of siblings; a word's trie has few branches
+    // per level
+    struct TrieNode {
+        int firstChild = -1;
+        int nextSibling = -1;
+        int term = -1;
+        char label = 0;
+    };
+
+    OpenAddressIndex<string> termIds;
+    vector<string> terms;
+    vector<vector<Posting>> postings; // per term
+    vector<TrieNode> trie = vector<TrieNode>(1); // node 0 is the root
+    size_t longestTerm = 0;
+    vector<vector<int>> internedTerms; // words of each interned string, by its ID
+
+    void clear() {
+        termIds.clear();
+        terms.clear();
+        postings.clear();
+        trie.assign(1, TrieNode());
+        longestTerm = 0;
+        internedTerms.clear();
+    }
+
+    void add(int position, const Item& item) {
+        addField(item.name, position, FIELD_NAME, true);
+        for (const auto& component : item.components) {
+            addField(component, position, FIELD_COMPONENT, true);
+        }
+        addInterned(item.category, position, FIELD_CATEGORY);
+        addInterned(item.condition, position, FIELD_CONDITION);
+    }
+
+    // Conditions and categories repeat across most of the inventory, so
+    // each distinct value is split into words only once
+    void addInterned(InternedString value, int position, uint8_t field) {
+        if (value.id >= internedTerms.size()) {
+            internedTerms.resize(value.id + 1);
+        }
+        vector<int>& words = internedTerms[value.id];
+        if (words.empty()) {
+            string token;
+            forEachSearchToken(value.str(), token, [&](const string& word) { words.push_back(termFor(word)); });
+        }
+        for (int term : words) {
+            addPosting(term, position, field);
+        }
+    }
+
+    // With `compounds`, adjacent words are also indexed joined together, so
+    // "powerbank" finds "Power Bank"
+    void addField(const string& text, int position, uint8_t field, bool compounds) {
+        string token, previous;
+        forEachSearchToken(text, token, [&](const string& word) {
+            addPosting(termFor(word), position, field);
+            bool joinable = compounds && !hasDigit(word);
+            if (joinable && !previous.empty()) {
+                addPosting(termFor(previous + word), position, field);
+            }
+            previous = joinable ? word : string();
+        });
+    }
+
+    int termFor(const string& token) {
+        int term = termIds.find(token);
+        if (term < 0) {
+            term = static_cast<int>(terms.size());
+            termIds.insert(token, term);
+            terms.push_back(token);
+            postings.emplace_back();
+            insertTrie(token, term);
+        }
+        return term;
+    }
+
+    void addPosting(int term, int position, uint8_t field) {
+        vector<Posting>& list = postings[term];
+        if (!list.empty() && list.back().position == position) {
+            list.back().fields |= field;
+        } else {
+            list.push_back({position, field});
+        }
+    }
+
+    int childOf(int node, char label) const {
+        int child = trie[node].firstChild;
+        while (child >= 0 && trie[child].label != label) {
+            child = trie[child].nextSibling;
+        }
+        return child;
+    }
+
+    void insertTrie(const string& token, int term) {
+        int node = 0;
+        for (char c : token) {
+            int child = childOf(node, c);
+            if (child < 0) {
+                child = static_cast<int>(trie.size());
+                TrieNode added;
+                added.nextSibling = trie[node].firstChild;
+                added.label = c;
+                trie.push_back(added);
+                trie[node].firstChild = child;
+            }
+            node = child;
+        }
+        trie[node].term = term;
+        longestTerm = max(longestTerm, token.size());
+    }
+
+    // Node reached by spelling `prefix`, or -1
+    int findNode(string_view prefix) const {
+        int node = 0;
+        for (size_t i = 0; i < prefix.size() && node >= 0; i++) {
+            node = childOf(node, prefix[i]);
+        }
+        return node;
+    }
+
+    // Appends terms under `node` until `out` holds `limit`, at any depth
+    void collectTerms(int node, size_t limit, pmr::vector<int>& out) const {
+        if (out.size() >= limit) {
+            return;
+        }
+        if (trie[node].term >= 0) {
+            out.push_back(trie[node].term);
+        }
+        for (int child = trie[node].firstChild; child >= 0; child = trie[child].nextSibling) {
+            if (out.size() >= limit) {
+                return;
+            }
+            collectTerms(child, limit, out);
+        }
+    }
+
+    // Terms within `maxDistance` edits of `word`, with their distance. The
+    // edit-distance table gains a row per trie level, so a whole branch is
+    // skipped once every cell in its row is over the limit.
+    void fuzzyTerms(string_view word, int maxDistance, pmr::vector<pair<int, int>>& out) const {
+        size_t width = word.size() + 1;
+        pmr::vector<int> rows((longestTerm + 1) * width, 0, out.get_allocator().resource());
+        for (size_t j = 0; j < width; j++) {
+            rows[j] = static_cast<int>(j);
+        }
+        for (int child = trie[0].firstChild; child >= 0; child = trie[child].nextSibling) {
+            fuzzyStep(child, 1, word, maxDistance, rows.data(), out);
+        }
+    }
+
+    void fuzzyStep(int node, size_t depth, string_view word, int maxDistance, int* rows,
+                   pmr::vector<pair<int, int>>& out) const {
+        size_t width = word.size() + 1;
+        const int* above = rows + (depth - 1) * width;
+        int* row = rows + depth * width;
+        row[0] = static_cast<int>(depth);
+        int best = row[0];
+        for (size_t j = 1; j < width; j++) {
+            int substitute = above[j - 1] + (word[j - 1] == trie[node].label ? 0 : 1);
+            row[j] = min({above[j] + 1, row[j - 1] + 1, substitute});
+            best = min(best, row[j]);
+        }
+        if (trie[node].term >= 0 && row[width - 1] <= maxDistance) {
+            out.push_back({trie[node].term, row[width - 1]});
+        }
+        if (best > maxDistance) {
+            return;
+        }
+        for (int child = trie[node].firstChild; child >= 0; child = trie[child].nextSibling) {
+            fuzzyStep(child, depth + 1, word, maxDistance, rows, out);
+        }
+    }
+};
+
+// Lookup structures over `inventory`, kept in step by addInventoryItem()
+struct InventoryIndex {
+    OpenAddressIndex<int> bySku;
+    OpenAddressIndex<string> byName;    // normalized name -> first item with that name
+    vector<int> nextWithSameName;       // chains items that share a name
+    vector<string> normalizedNames;     // per position, computed once
+    vector<int> byCategory[CATEGORY_COUNT];
+    FullTextIndex text;
+};
+
+// Offset of local time from UTC at `timestamp`, so sales either side of a
+// daylight saving change land in their own local hour and day
+int64_t localTimeOffset(time_t timestamp) {
+    tm local;
+#ifdef _WIN32
+    localtime_s(&local, &timestamp);
+#else
+    localtime_r(&timestamp, &local);
+#endif
+    // tm_gmtoff is not portable: turn the local fields back into seconds
+    // (days-from-civil) and compare
+    int64_t year = local.tm_year + 1900 - (local.tm_mon < 2 ? 1 : 0);
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t shiftedMonth = (local.tm_mon + 10) % 12; // March is 0
+    int64_t dayOfYear = (153 * shiftedMonth + 2) / 5 + local.tm_mday - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = era * 146097 + dayOfEra - 719468;
+    int64_t localSeconds = days * 86400 + local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+    return localSeconds - static_cast<int64_t>(timestamp);
+}
+
+// Offsets change at most a couple of times a year, never twice in a week,
+// so the offset is cached per week: a week with the same offset at both ends
+// has it throughout, and only the weeks with a change ask localtime() for
+// every timestamp
+int64_t toLocalTime(time_t timestamp) {
+    const int64_t WEEK = 7 * 86400;
+    struct CachedWeek {
+        int64_t week = INT64_MIN;
+        int64_t offset = 0;
+        bool uniform = false;
+    };
+    thread_local CachedWeek cache[64];
+    int64_t seconds = static_cast<int64_t>(timestamp);
+    int64_t week = (seconds >= 0 ? seconds : seconds - (WEEK - 1)) / WEEK;
+    CachedWeek& entry = cache[week & 63];
+    if (entry.week != week) {
+        entry.week = week;
+        entry.offset = localTimeOffset(static_cast<time_t>(week * WEEK));
+        entry.uniform = entry.offset == localTimeOffset(static_cast<time_t>(week * WEEK + WEEK - 1));
+    }
+    return seconds + (entry.uniform ? entry.offset : localTimeOffset(timestamp));
+}
+
+struct SalesBucket {
+    uint32_t sales = 0;
+    long long revenue = 0;
+};
+
+// Exact top-N by sales count. Counts only ever grow by one, so an item can
+// only enter the list by overtaking the current last entry.
+struct TopSellers {
+    vector<pair<uint32_t, uint32_t>> entries; // (item ID, sales), highest first
+
+    void update(uint32_t itemId, uint32_t sales) {
+        size_t i = 0;
+        while (i < entries.size() && entries[i].first != itemId) {
+            i++;
+        }
+        if (i == entries.size()) {
+            if (entries.size() < TOP_SELLERS_TRACKED) {
+                entries.push_back({itemId, sales});
+            } else if (sales > entries.back().second) {
+                i = entries.size() - 1;
+                entries[i] = {itemId, sales};
+            } else {
+                return;
+            }
+        }
+        entries[i].second = sales;
+        while (i > 0 && entries[i - 1].second < entries[i].second) {
+            swap(entries[i - 1], entries[i]);
+            i--;
+        }
+    }
+};
+
+// Running sales totals, updated as each sale is recorded so reports never
+// have to rescan the history
+struct SalesAggregates {
+    long long totalRevenue = 0;
+    vector<uint32_t> itemSales;        // by item ID
+    vector<long long> itemRevenue;     // by item ID
+    unordered_map<int64_t, SalesBucket> byDay;
+    SalesBucket byHour[24];
+    TopSellers topSellers;
+
+    void record(uint32_t itemId, int price, int64_t localTime) {
+        if (itemId >= itemSales.size()) {
+            itemSales.resize(itemId + 1, 0);
+            itemRevenue.resize(itemId + 1, 0);
+        }
+        totalRevenue += price;
+        itemRevenue[itemId] += price;
+        topSellers.update(itemId, ++itemSales[itemId]);
+
+        int64_t day = localTime >= 0 ? localTime / 86400 : (localTime - 86399) / 86400;
+        SalesBucket& dayBucket = byDay[day];
+        dayBucket.sales++;
+        dayBucket.revenue += price;
+        SalesBucket& hourBucket = byHour[(localTime - day * 86400) / 3600];
+        hourBucket.sales++;
+        hourBucket.revenue += price;
+    }
+
+    void rebuildTopSellers() {
+        topSellers.entries.clear();
+        for (uint32_t id = 0; id < itemSales.size(); id++) {
+            if (itemSales[id] > 0) {
+                topSellers.entries.push_back({id, itemSales[id]});
+            }
+        }
+        size_t top = min(TOP_SELLERS_TRACKED, topSellers.entries.size());
+        partial_sort(topSellers.entries.begin(), topSellers.entries.begin() + top, topSellers.entries.end(),
+                     [](const pair<uint32_t, uint32_t>& a, const pair<uint32_t, uint32_t>& b) {
+                         return a.second > b.second;
+                     });
+        topSellers.entries.resize(top);
+    }
+
+    void clear() {
+        *this = SalesAggregates();
+    }
+};
+
+// Struct-of-arrays sales history. Reports scan contiguous columns instead
+// of walking Transaction objects that each own a heap string.
+struct TransactionStore {
+    vector<uint32_t> itemIds;   // NameDictionary IDs
+    vector<int32_t> prices;
+    vector<int64_t> timestamps;
+    NameDictionary itemNames;
+    SalesAggregates stats;
+    size_t pendingRows = 0;     // rows still in the mapped snapshot, counted in stats
+
+    size_t size() const { return prices.size(); }
+    bool empty() const { return prices.empty() && pendingRows == 0; }
+    size_t totalRows() const { return prices.size() + pendingRows; }
+
+    void reserve(size_t count) {
+        itemIds.reserve(count);
+        prices.reserve(count);
+        timestamps.reserve(count);
+    }
+
+    void append(const Transaction& trans) {
+        uint32_t itemId = itemNames.intern(trans.itemName);
+        itemIds.push_back(itemId);
+        prices.push_back(trans.price);
+        timestamps.push_back(static_cast<int64_t>(trans.timestamp));
+        stats.record(itemId, trans.price, toLocalTime(trans.timestamp));
+    }
+
+    const string& itemName(size_t row) const { return itemNames.names[itemIds[row]]; }
+
+    // Recomputes the aggregates from the decoded rows (snapshots before version 4)
+    void rebuildStats() {
+        stats.clear();
+        for (size_t i = 0; i < size(); i++) {
+            stats.record(itemIds[i], prices[i], toLocalTime(static_cast<time_t>(timestamps[i])));
+        }
+    }
+
+    Transaction row(size_t row) const {
+        return {itemName(row), prices[row], static_cast<time_t>(timestamps[row])};
+    }
+
+    void clear() {
+        itemIds.clear();
+        prices.clear();
+        timestamps.clear();
+        itemNames.clear();
+        stats.clear();
+        pendingRows = 0;
+    }
+};
+
+// Columnar recycling log, laid out like TransactionStore
+struct RecyclingStore {
+    vector<uint32_t> itemIds;
+    vector<float> weights;
+    vector<int64_t> timestamps;
+    NameDictionary itemNames;
+
+    size_t size() const { return weights.size(); }
+    bool empty() const { return weights.empty(); }
+
+    void append(const RecyclingRecord& record) {
+        itemIds.push_back(itemNames.intern(record.itemName));
+        weights.push_back(record.weight);
+        timestamps.push_back(static_cast<int64_t>(record.timestamp));
+    }
+};
+
+// Writes `count` decimal digits of `value`, zero-padded
+void writeDigits(char* out, int64_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        out[i] = char('0' + value % 10);
+        value /= 10;
+    }
+}
+
+// "yyyy-mm-dd hh:mm:ss" from local seconds since the epoch, without going
+// through localtime() or a stream (civil-from-days on the day number)
+void formatDateTime(int64_t localSeconds, char out[19]) {
+    int64_t days = localSeconds >= 0 ? localSeconds / 86400 : (localSeconds - 86399) / 86400;
+    int64_t seconds = localSeconds - days * 86400;
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t shiftedMonth = (5 * dayOfYear + 2) / 153; // March is 0
+    int64_t day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    int64_t month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+    writeDigits(out, year, 4);
+    out[4] = '-';
+    writeDigits(out + 5, month, 2);
+    out[7] = '-';
+    writeDigits(out + 8, day, 2);
+    out[10] = ' ';
+    writeDigits(out + 11, seconds / 3600, 2);
+    out[13] = ':';
+    writeDigits(out + 14, seconds / 60 % 60, 2);
+    out[16] = ':';
+    writeDigits(out + 17, seconds % 60, 2);
+}
+
+// The receipt layout compiled once: a frame with every label and border in
+// place, plus the offset and width of each value slot. Rendering copies the
+// frame and writes values right-aligned into their slots, so every receipt
+// is exactly size() bytes and needs no allocation. Values wider than their
+// slot are cut rather than pushing the border out of line.
+struct ReceiptTemplate {
+    enum Field {
+        FIELD_ID,
+        FIELD_DATE,
+        FIELD_CUSTOMER,
+        FIELD_ITEM,
+        FIELD_CONDITION,
+        FIELD_PRICE,
+        FIELD_PAYMENT,
+        FIELD_CHANGE,
+        FIELD_POINTS,
+        FIELD_COUNT
+    };
+    struct Slot {
+        size_t offset;
+        size_t width;
+    };
+    static const size_t INNER_WIDTH = 41; // between the two '|'
+    string frame;
+    Slot slots[FIELD_COUNT];
+
+    ReceiptTemplate() {
+        rule();
+        banner("T.I.P. Recycle and Repair Shop");
+        banner("RECEIPT");
+        rule();
+        field(FIELD_ID, "Receipt ID: ");
+        field(FIELD_DATE, "Date: ");
+        field(FIELD_CUSTOMER, "Customer: ");
+        rule();
+        field(FIELD_ITEM, "Item: ");
+        field(FIELD_CONDITION, "Condition: ");
+        field(FIELD_PRICE, "Price (P): ");
+        field(FIELD_PAYMENT, "Payment (P): ");
+        field(FIELD_CHANGE, "Change (P): ");
+        field(FIELD_POINTS, "Loyalty Points: ");
+        rule();
+        banner("Thank you for your purchase!");
+        rule();
+    }
+
+    size_t size() const { return frame.size(); }
+
+    void rule() {
+        frame += '+';
+        frame.append(INNER_WIDTH, '-');
+        frame += "+\n";
+    }
+
+    void banner(const string& text) {
+        size_t left = (INNER_WIDTH - text.size()) / 2;
+        frame += '|';
+        frame.append(left, ' ');
+        frame += text;
+        frame.append(INNER_WIDTH - left - text.size(), ' ');
+        frame += "|\n";
+    }
+
+    void field(Field id, const string& label) {
+        frame += "| ";
+        frame += label;
+        slots[id] = {frame.size(), INNER_WIDTH - 2 - label.size()};
+        frame.append(slots[id].width, ' ');
+        frame += " |\n";
+    }
+
+    void write(char* out, Field id, const char* text, size_t length) const {
+        const Slot& slot = slots[id];
+        length = min(length, slot.width);
+        memcpy(out + slot.offset + slot.width - length, text, length);
+    }
+
+    void write(char* out, Field id, const string& text) const { write(out, id, text.data(), text.size()); }
+
+    void write(char* out, Field id, long long value) const {
+        char digits[24];
+        to_chars_result result = to_chars(digits, digits + sizeof(digits), value);
+        write(out, id, digits, result.ptr - digits);
+    }
+
+    // Fills `out`, which must hold size() bytes; returns size()
+    size_t render(const Receipt& receipt, char* out) const {
+        memcpy(out, frame.data(), frame.size());
+        char date[19];
+        formatDateTime(toLocalTime(receipt.timestamp), date);
+        write(out, FIELD_ID, receipt.id);
+        write(out, FIELD_DATE, date, sizeof(date));
+        write(out, FIELD_CUSTOMER, receipt.username);
+        write(out, FIELD_ITEM, receipt.itemName);
+        write(out, FIELD_CONDITION, receipt.condition);
+        write(out, FIELD_PRICE, receipt.price);
+        write(out, FIELD_PAYMENT, receipt.payment);
+        write(out, FIELD_CHANGE, receipt.change);
+        write(out, FIELD_POINTS, receipt.loyaltyPoints);
+        return frame.size();
+    }
+};
+
+// Receipt archive on disk. shop_receipts.dat holds fixed-size records in ID
+// order, so a receipt's offset is computed from its ID and any page of
+// consecutive receipts is one read. Receipts are issued in time order, so a
+// date is found by binary search over the records. Each record also links
+// to the same customer's previous receipt. shop_receipts.idx stores every
+// customer's newest receipt ID, so a customer's history is a walk back
+// from there that never reads other customers' receipts.
+const uint32_t RECEIPT_ARCHIVE_MAGIC = 0x52504954; // "TIPR"
+const uint32_t RECEIPT_ARCHIVE_VERSION = 1;
+
+struct ReceiptArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t indexedRecords; // index file only: receipts reflected in it
+};
+
+struct ReceiptRecord {
+    uint32_t id;
+    uint32_t previousForCustomer; // 0 for a customer's first receipt
+    int64_t timestamp;
+    int32_t price;
+    int32_t payment;
+    int32_t change;
+    int32_t loyaltyPoints;
+    char username[40];            // NUL-padded; longer values are cut
+    char itemName[48];
+    char condition[32];
+};
+
+struct CustomerIndexRecord {
+    char username[40];
+    uint32_t latestReceipt;
+    uint32_t receiptCount;
+};
+
+template <size_t N>
+void storeField(char (&field)[N], const string& value) {
+    memset(field, 0, N);
+    memcpy(field, value.data(), min(value.size(), N));
+}
+
+template <size_t N>
+string loadField(const char (&field)[N]) {
+    return string(field, strnlen(field, N));
+}
+
+struct ReceiptArchive {
+    string dataPath;
+    string indexPath;
+    fstream data;
+    fstream index;
+    bool opened = false;
+    uint32_t count = 0;
+    vector<CustomerIndexRecord> customers;
+    unordered_map<string, size_t> customerSlot; // stored (possibly cut) username -> customers[]
+    mutex lock;
+
+    ReceiptArchive(const string& data, const string& index) : dataPath(data), indexPath(index) {}
+
+    // Customers are indexed under the name as stored, i.e. cut to fit
+    static string storedName(const string& username) {
+        return username.substr(0, sizeof(ReceiptRecord::username));
+    }
+
+    static uint64_t offsetOf(uint32_t id) {
+        return sizeof(ReceiptArchiveHeader) + uint64_t(id - 1) * sizeof(ReceiptRecord);
+    }
+
+    // Opens both files, creating them if missing. An index that is missing,
+    // corrupt or behind the data file (a crash between the two writes) is
+    // caught up from the records it has not seen.
+    bool open() {
+        if (opened) {
+            return true;
+        }
+        if (!openFile(data, dataPath)) {
+            return false;
+        }
+        data.seekg(0, ios::end);
+        uint64_t size = static_cast<uint64_t>(data.tellg());
+        ReceiptArchiveHeader header = {};
+        if (size >= sizeof(header)) {
+            data.seekg(0);
+            data.read(reinterpret_cast<char*>(&header), sizeof(header));
+            if (header.magic != RECEIPT_ARCHIVE_MAGIC || header.version != RECEIPT_ARCHIVE_VERSION ||
+                header.recordSize != sizeof(ReceiptRecord)) {
+                cout << "Receipt archive " << dataPath << " is corrupt or from an unsupported version." << endl;
+                data.close();
+                return false;
+            }
+            // A torn last record is ignored and overwritten by the next receipt
+            count = static_cast<uint32_t>((size - sizeof(header)) / sizeof(ReceiptRecord));
+        } else {
+            header = {RECEIPT_ARCHIVE_MAGIC, RECEIPT_ARCHIVE_VERSION, sizeof(ReceiptRecord), 0};
+            data.seekp(0);
+            data.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            data.flush();
+            count = 0;
+        }
+
+        customers.clear();
+        customerSlot.clear();
+        uint32_t indexed = 0;
+        if (!openFile(index, indexPath) || !loadIndex(indexed) || indexed > count) {
+            customers.clear();
+            customerSlot.clear();
+            indexed = 0;
+        }
+        for (uint32_t id = indexed + 1; id <= count; id++) {
+            ReceiptRecord record;
+            if (!readRecord(id, record)) {
+                // Unreadable from here on: treat it like a torn tail
+                count = id - 1;
+                break;
+            }
+            noteCustomer(record);
+        }
+        opened = true;
+        saveIndex();
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> guard(lock);
+        if (opened) {
+            data.close();
+            index.close();
+            opened = false;
+        }
+    }
+
+    // Empties the archive (used when replacing all shop data)
+    void clear() {
+        close();
+        remove(dataPath.c_str());
+        remove(indexPath.c_str());
+        count = 0;
+        customers.clear();
+        customerSlot.clear();
+    }
+
+    static bool openFile(fstream& file, const string& path) {
+        file.close();
+        file.clear();
+        file.open(path, ios::in | ios::out | ios::binary);
+        if (!file.is_open()) {
+            file.clear();
+            file.open(path, ios::in | ios::out | ios::binary | ios::trunc);
+        }
+        return file.is_open();
+    }
+
+    bool loadIndex(uint32_t& indexed) {
+        ReceiptArchiveHeader header = {};
+        index.seekg(0);
+        if (!index.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != RECEIPT_ARCHIVE_MAGIC ||
+            header.version != RECEIPT_ARCHIVE_VERSION || header.recordSize != sizeof(CustomerIndexRecord)) {
+            index.clear();
+            return false;
+        }
+        CustomerIndexRecord entry;
+        while (index.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+            if (entry.latestReceipt > header.indexedRecords) {
+                index.clear();
+                return false;
+            }
+            customerSlot[loadField(entry.username)] = customers.size();
+            customers.push_back(entry);
+        }
+        index.clear();
+        indexed = header.indexedRecords;
+        return true;
+    }
+
+    void saveIndex() {
+        index.seekp(0);
+        ReceiptArchiveHeader header = {RECEIPT_ARCHIVE_MAGIC, RECEIPT_ARCHIVE_VERSION, sizeof(CustomerIndexRecord), count};
+        index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        index.write(reinterpret_cast<const char*>(customers.data()), customers.size() * sizeof(CustomerIndexRecord));
+        index.flush();
+    }
+
+    // Links `record` into its customer's chain in memory; returns the slot
+    size_t noteCustomer(ReceiptRecord& record) {
+        string key = loadField(record.username);
+        auto it = customerSlot.find(key);
+        if (it == customerSlot.end()) {
+            CustomerIndexRecord entry = {};
+            storeField(entry.username, key);
+            it = customerSlot.emplace(key, customers.size()).first;
+            customers.push_back(entry);
+        }
+        CustomerIndexRecord& entry = customers[it->second];
+        if (record.id > entry.latestReceipt) {
+            entry.latestReceipt = record.id;
+            entry.receiptCount++;
+        }
+        return it->second;
+    }
+
+    bool readRecord(uint32_t id, ReceiptRecord& record) {
+        data.seekg(offsetOf(id));
+        if (!data.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            data.clear();
+            return false;
+        }
+        return true;
+    }
+
+    static Receipt toReceipt(const ReceiptRecord& record) {
+        return {static_cast<int>(record.id), loadField(record.username), loadField(record.itemName),
+                loadField(record.condition), record.price, record.payment, record.change, record.loyaltyPoints,
+                static_cast<time_t>(record.timestamp)};
+    }
+
+    // Stores `receipt` under the next ID, which it returns (0 on failure).
+    // The record goes out first and the customer's index slot second.
+    int append(Receipt receipt) {
+        lock_guard<mutex> guard(lock);
+        if (!open()) {
+            return 0;
+        }
+        ReceiptRecord record = {};
+        record.id = count + 1;
+        record.timestamp = static_cast<int64_t>(receipt.timestamp);
+        record.price = receipt.price;
+        record.payment = receipt.payment;
+        record.change = receipt.change;
+        record.loyaltyPoints = receipt.loyaltyPoints;
+        storeField(record.username, receipt.username);
+        storeField(record.itemName, receipt.itemName);
+        storeField(record.condition, receipt.condition);
+        auto it = customerSlot.find(storedName(receipt.username));
+        record.previousForCustomer = it == customerSlot.end() ? 0 : customers[it->second].latestReceipt;
+
+        data.seekp(offsetOf(record.id));
+        data.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        data.flush();
+        if (!data) {
+            data.clear();
+            return 0;
+        }
+        count = record.id;
+
+        size_t slot = noteCustomer(record);
+        index.seekp(sizeof(ReceiptArchiveHeader) + slot * sizeof(CustomerIndexRecord));
+        index.write(reinterpret_cast<const char*>(&customers[slot]), sizeof(CustomerIndexRecord));
+        index.seekp(offsetof(ReceiptArchiveHeader, indexedRecords));
+        index.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        index.flush();
+        return static_cast<int>(record.id);
+    }
+
+    bool find(int id, Receipt& out) {
+        lock_guard<mutex> guard(lock);
+        ReceiptRecord record;
+        if (!open() || id <= 0 || static_cast<uint32_t>(id) > count || !readRecord(id, record)) {
+            return false;
+        }
+        out = toReceipt(record);
+        return true;
+    }
+
+    uint32_t size() {
+        lock_guard<mutex> guard(lock);
+        open();
+        return count;
+    }
+
+    // First ID issued at or after `when` (count + 1 if none)
+    uint32_t firstAtOrAfter(time_t when) {
+        lock_guard<mutex> guard(lock);
+        if (!open()) {
+            return 1;
+        }
+        uint32_t low = 1, high = count + 1;
+        ReceiptRecord record;
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (readRecord(mid, record) && record.timestamp < static_cast<int64_t>(when)) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    // Up to `limit` consecutive receipts from `firstId`, in one read
+    size_t readRange(uint32_t firstId, size_t limit, vector<Receipt>& out) {
+        lock_guard<mutex> guard(lock);
+        out.clear();
+        if (!open() || firstId == 0 || firstId > count) {
+            return 0;
+        }
+        vector<ReceiptRecord> records(min<size_t>(limit, count - firstId + 1));
+        data.seekg(offsetOf(firstId));
+        data.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(ReceiptRecord));
+        records.resize(data.gcount() / sizeof(ReceiptRecord));
+        data.clear();
+        out.reserve(records.size());
+        for (const auto& record : records) {
+            out.push_back(toReceipt(record));
+        }
+        return out.size();
+    }
+
+    // One page of receipts, newest first, starting at ID `cursor` (0 for the
+    // newest). With a customer only their receipts are read. `cursor` is set
+    // to where the next page starts, or 0 after the oldest receipt.
+    size_t page(const string& customer, uint32_t& cursor, size_t limit, vector<Receipt>& out) {
+        out.clear();
+        if (customer.empty()) {
+            uint32_t last = cursor ? cursor : size();
+            if (last == 0) {
+                cursor = 0;
+                return 0;
+            }
+            uint32_t first = last > limit ? last - static_cast<uint32_t>(limit) + 1 : 1;
+            readRange(first, last - first + 1, out);
+            reverse(out.begin(), out.end());
+            cursor = first - 1;
+            return out.size();
+        }
+
+        lock_guard<mutex> guard(lock);
+        if (!open()) {
+            return 0;
+        }
+        if (cursor == 0) {
+            auto it = customerSlot.find(storedName(customer));
+            cursor = it == customerSlot.end() ? 0 : customers[it->second].latestReceipt;
+        }
+        ReceiptRecord record;
+        while (cursor != 0 && out.size() < limit && readRecord(cursor, record)) {
+            out.push_back(toReceipt(record));
+            cursor = record.previousForCustomer;
+        }
+        return out.size();
+    }
+
+    uint32_t customerReceiptCount(const string& customer) {
+        lock_guard<mutex> guard(lock);
+        open();
+        auto it = customerSlot.find(storedName(customer));
+        return it == customerSlot.end() ? 0 : customers[it->second].receiptCount;
+    }
+};
+
+typedef array<uint8_t, 32> Sha256Digest;
+
+// SHA-256 (FIPS 180-4), for the warranty ledger's hash chain and checkpoints
+struct Sha256 {
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    uint8_t block[64];
+    size_t blockUsed = 0;
+    uint64_t totalBytes = 0;
+
+    static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress(const uint8_t* chunk) {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = uint32_t(chunk[i * 4]) << 24 | uint32_t(chunk[i * 4 + 1]) << 16 |
+                   uint32_t(chunk[i * 4 + 2]) << 8 | uint32_t(chunk[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    void update(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        totalBytes += size;
+        while (size > 0) {
+            size_t take = min(size, sizeof(block) - blockUsed);
+            memcpy(block + blockUsed, bytes, take);
+            blockUsed += take;
+            bytes += take;
+            size -= take;
+            if (blockUsed == sizeof(block)) {
+                compress(block);
+                blockUsed = 0;
+            }
+        }
+    }
+
+    Sha256Digest finish() {
+        uint64_t bits = totalBytes * 8;
+        uint8_t padding = 0x80;
+        update(&padding, 1);
+        padding = 0;
+        while (blockUsed != 56) {
+            update(&padding, 1);
+        }
+        uint8_t length[8];
+        for (int i = 0; i < 8; i++) {
+            length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        }
+        update(length, 8);
+        Sha256Digest digest;
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 4; j++) {
+                digest[i * 4 + j] = static_cast<uint8_t>(state[i] >> (24 - 8 * j));
+            }
+        }
+        return digest;
+    }
+};
+
+string toHex(const Sha256Digest& digest, size_t bytes = 32) {
+    static const char DIGITS[] = "0123456789abcdef";
+    string text;
+    for (size_t i = 0; i < min(bytes, digest.size()); i++) {
+        text += DIGITS[digest[i] >> 4];
+        text += DIGITS[digest[i] & 15];
+    }
+    return text;
+}
+
+// Merkle tree node over two children. The 0x01 prefix keeps a node from
+// ever being taken for a record hash.
+Sha256Digest merkleParent(const Sha256Digest& left, const Sha256Digest& right) {
+    Sha256 hash;
+    uint8_t tag = 1;
+    hash.update(&tag, 1);
+    hash.update(left.data(), left.size());
+    hash.update(right.data(), right.size());
+    return hash.finish();
+}
+
+// Every level of the tree over `leaves`, leaves first and root last. A
+// level with an odd count pairs its last node with itself.
+vector<Sha256Digest> merkleLevels(const Sha256Digest* leaves, size_t count) {
+    vector<Sha256Digest> nodes(leaves, leaves + count);
+    nodes.reserve(count * 2);
+    for (size_t begin = 0, width = count; width > 1; width = (width + 1) / 2) {
+        for (size_t i = 0; i < width; i += 2) {
+            const Sha256Digest& left = nodes[begin + i];
+            nodes.push_back(merkleParent(left, i + 1 < width ? nodes[begin + i + 1] : left));
+        }
+        begin += width;
+    }
+    return nodes;
+}
+
+// Append-only warranty ledger. shop_warranty.dat holds fixed-size records,
+// each carrying the SHA-256 of its own fields and of the record before it,
+// so changing any record breaks every link after it. Every
+// WARRANTY_CHECKPOINT_RECORDS records, the Merkle root of that block and the
+// chain hash at its end go to shop_warranty.ckp. A warranty is then proven
+// against its block's root with log2(block) hashes, and an audit checks the
+// blocks in parallel.
+const uint32_t WARRANTY_LEDGER_MAGIC = 0x57504954; // "TIPW"
+const uint32_t WARRANTY_LEDGER_VERSION = 1;
+
+struct WarrantyLedgerHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t blockRecords; // records per checkpoint
+};
+
+struct WarrantyRecord {
+    uint32_t sequence; // 1-based position in the ledger
+    uint32_t durationDays;
+    int64_t registered;
+    char serial[48];   // NUL-padded; longer values are cut
+    Sha256Digest previousHash; // zeros for the first record
+    Sha256Digest hash;         // over every field above
+
+    Sha256Digest computeHash() const {
+        Sha256 sha;
+        sha.update(this, offsetof(WarrantyRecord, hash));
+        return sha.finish();
+    }
+
+    time_t expires() const { return static_cast<time_t>(registered + int64_t(durationDays) * 86400); }
+};
+
+struct WarrantyCheckpoint {
+    uint32_t firstRecord;
+    uint32_t recordCount;
+    Sha256Digest merkleRoot;
+    Sha256Digest chainHash; // hash of the block's last record
+};
+
+struct WarrantyProof {
+    WarrantyRecord record;
+    bool checkpointed = false; // false: the record is in the open block
+    size_t block = 0;
+    size_t hashes = 0;         // hashes computed to reach the root
+    bool valid = false;
+};
+
+struct WarrantyAudit {
+    size_t records = 0;
+    size_t blocks = 0;
+    unsigned threads = 1;
+    uint32_t firstBadRecord = 0; // 0 when the whole ledger verified
+    double seconds = 0;
+};
+
+struct WarrantyLedger {
+    string dataPath;
+    string checkpointPath;
+    fstream data;
+    fstream checkpointFile;
+    bool opened = false;
+    vector<Sha256Digest> hashes;          // stored hash of each record, by sequence - 1
+    vector<WarrantyCheckpoint> checkpoints;
+    vector<vector<Sha256Digest>> trees;   // Merkle levels of each checkpointed block
+    OpenAddressIndex<string> bySerial;    // stored serial -> latest sequence
+    mutex lock;
+
+    WarrantyLedger(const string& data, const string& checkpoints) : dataPath(data), checkpointPath(checkpoints) {}
+
+    static string storedSerial(const string& serial) {
+        return serial.substr(0, sizeof(WarrantyRecord::serial));
+    }
+
+    static uint64_t offsetOf(uint32_t sequence) {
+        return sizeof(WarrantyLedgerHeader) + uint64_t(sequence - 1) * sizeof(WarrantyRecord);
+    }
+
+    uint32_t size() const { return static_cast<uint32_t>(hashes.size()); }
+
+    // Opens both files, creating them if missing, and loads the serial
+    // index and stored hashes. Blocks completed before a crash got to write
+    // their checkpoint are checkpointed now; checkpoints for records that
+    // are no longer there mean the ledger was cut short, and it is refused.
+    bool open() {
+        if (opened) {
+            return true;
+        }
+        if (!ReceiptArchive::openFile(data, dataPath) || !ReceiptArchive::openFile(checkpointFile, checkpointPath)) {
+            return false;
+        }
+        if (!openHeader(data, sizeof(WarrantyRecord)) || !openHeader(checkpointFile, sizeof(WarrantyCheckpoint))) {
+            cout << "Warranty ledger " << dataPath << " is corrupt or from an unsupported version." << endl;
+            data.close();
+            checkpointFile.close();
+            return false;
+        }
+
+        hashes.clear();
+        checkpoints.clear();
+        trees.clear();
+        bySerial.clear();
+        data.seekg(0, ios::end);
+        // A torn last record is ignored and overwritten by the next registration
+        uint32_t count = static_cast<uint32_t>((uint64_t(data.tellg()) - sizeof(WarrantyLedgerHeader)) /
+                                               sizeof(WarrantyRecord));
+        data.seekg(offsetOf(1));
+        WarrantyRecord record;
+        for (uint32_t sequence = 1; sequence <= count && data.read(reinterpret_cast<char*>(&record), sizeof(record));
+             sequence++) {
+            noteRecord(record);
+        }
+        data.clear();
+
+        checkpointFile.seekg(sizeof(WarrantyLedgerHeader));
+        WarrantyCheckpoint checkpoint;
+        while (checkpointFile.read(reinterpret_cast<char*>(&checkpoint), sizeof(checkpoint))) {
+            // Blocks are written back to back, each WARRANTY_CHECKPOINT_RECORDS long
+            uint64_t expectedFirst = uint64_t(checkpoints.size()) * WARRANTY_CHECKPOINT_RECORDS + 1;
+            const char* problem = nullptr;
+            if (checkpoint.firstRecord != expectedFirst || checkpoint.recordCount != WARRANTY_CHECKPOINT_RECORDS) {
+                problem = "has corrupt checkpoints";
+            } else if (uint64_t(checkpoint.firstRecord) + checkpoint.recordCount - 1 > size()) {
+                problem = "is shorter than its checkpoints";
+            }
+            if (problem) {
+                cout << "Warranty ledger " << dataPath << " " << problem << "." << endl;
+                checkpointFile.close();
+                data.close();
+                return false;
+            }
+            checkpoints.push_back(checkpoint);
+            trees.push_back(merkleLevels(&hashes[checkpoint.firstRecord - 1], checkpoint.recordCount));
+        }
+        checkpointFile.clear();
+        opened = true;
+        while ((checkpoints.size() + 1) * WARRANTY_CHECKPOINT_RECORDS <= size()) {
+            writeCheckpoint();
+        }
+        return true;
+    }
+
+    // Checks the header of an existing file, or writes one to a new one
+    static bool openHeader(fstream& file, uint32_t recordSize) {
+        file.seekg(0, ios::end);
+        WarrantyLedgerHeader header = {WARRANTY_LEDGER_MAGIC, WARRANTY_LEDGER_VERSION, recordSize,
+                                       static_cast<uint32_t>(WARRANTY_CHECKPOINT_RECORDS)};
+        if (file.tellg() < static_cast<streamoff>(sizeof(header))) {
+            file.seekp(0);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.flush();
+            return static_cast<bool>(file);
+        }
+        WarrantyLedgerHeader stored;
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(&stored), sizeof(stored));
+        return file && memcmp(&stored, &header, sizeof(header)) == 0;
+    }
+
+    // A renewal appends a new record, and the serial resolves to the newest
+    void noteRecord(const WarrantyRecord& record) {
+        hashes.push_back(record.hash);
+        bySerial.assign(loadField(record.serial), static_cast<int>(record.sequence));
+    }
+
+    void writeCheckpoint() {
+        uint32_t first = static_cast<uint32_t>(checkpoints.size() * WARRANTY_CHECKPOINT_RECORDS) + 1;
+        WarrantyCheckpoint checkpoint = {};
+        checkpoint.firstRecord = first;
+        checkpoint.recordCount = static_cast<uint32_t>(WARRANTY_CHECKPOINT_RECORDS);
+        trees.push_back(merkleLevels(&hashes[first - 1], checkpoint.recordCount));
+        checkpoint.merkleRoot = trees.back().back();
+        checkpoint.chainHash = hashes[first + checkpoint.recordCount - 2];
+        checkpoints.push_back(checkpoint);
+        checkpointFile.seekp(sizeof(WarrantyLedgerHeader) + (checkpoints.size() - 1) * sizeof(WarrantyCheckpoint));
+        checkpointFile.write(reinterpret_cast<const char*>(&checkpoint), sizeof(checkpoint));
+        checkpointFile.flush();
+    }
+
+    void close() {
+        lock_guard<mutex> guard(lock);
+        if (opened) {
+            data.close();
+            checkpointFile.close();
+            opened = false;
+        }
+    }
+
+    void clear() {
+        close();
+        remove(dataPath.c_str());
+        remove(checkpointPath.c_str());
+        hashes.clear();
+        checkpoints.clear();
+        trees.clear();
+        bySerial.clear();
+    }
+
+    // Appends a registration chained to the current last record; returns
+    // its sequence, or 0 on failure
+    uint32_t append(const string& serial, uint32_t durationDays, time_t registered) {
+        lock_guard<mutex> guard(lock);
+        if (!open()) {
+            return 0;
+        }
+        WarrantyRecord record = {};
+        record.sequence = size() + 1;
+        record.durationDays = durationDays;
+        record.registered = static_cast<int64_t>(registered);
+        storeField(record.serial, serial);
+        if (!hashes.empty()) {
+            record.previousHash = hashes.back();
+        }
+        record.hash = record.computeHash();
+        data.seekp(offsetOf(record.sequence));
+        if (!data.write(reinterpret_cast<const char*>(&record), sizeof(record)) || !data.flush()) {
+            data.clear();
+            return 0;
+        }
+        noteRecord(record);
+        if (size() % WARRANTY_CHECKPOINT_RECORDS == 0) {
+            writeCheckpoint();
+        }
+        return record.sequence;
+    }
+
+    bool readRecord(uint32_t sequence, WarrantyRecord& record) {
+        data.seekg(offsetOf(sequence));
+        if (!data.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            data.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Looks up the serial's latest record and proves it is in the ledger:
+    // its hash is recomputed from the record as read, then combined up its
+    // block's Merkle tree and compared with the checkpointed root. Records
+    // newer than the last checkpoint are checked by following the chain
+    // from the checkpoint's last record instead.
+    bool prove(const string& serial, WarrantyProof& proof) {
+        lock_guard<mutex> guard(lock);
+        if (!open()) {
+            return false;
+        }
+        int sequence = bySerial.find(string_view(storedSerial(serial)));
+        if (sequence <= 0 || !readRecord(static_cast<uint32_t>(sequence), proof.record)) {
+            return false;
+        }
+        Sha256Digest hash = proof.record.computeHash();
+        proof.hashes = 1;
+        size_t position = static_cast<size_t>(sequence - 1);
+        proof.block = position / WARRANTY_CHECKPOINT_RECORDS;
+        proof.checkpointed = proof.block < checkpoints.size();
+        if (proof.checkpointed) {
+            const vector<Sha256Digest>& tree = trees[proof.block];
+            size_t index = position % WARRANTY_CHECKPOINT_RECORDS;
+            for (size_t begin = 0, width = checkpoints[proof.block].recordCount; width > 1;
+                 begin += width, width = (width + 1) / 2, index /= 2) {
+                size_t sibling = index ^ 1;
+                const Sha256Digest& other = tree[begin + (sibling < width ? sibling : index)];
+                hash = index % 2 == 0 ? merkleParent(hash, other) : merkleParent(other, hash);
+                proof.hashes++;
+            }
+            proof.valid = hash == checkpoints[proof.block].merkleRoot;
+        } else {
+            // Relink the open block from the last checkpoint to the newest record
+            Sha256Digest expected = checkpoints.empty() ? Sha256Digest() : checkpoints.back().chainHash;
+            uint32_t first = static_cast<uint32_t>(checkpoints.size() * WARRANTY_CHECKPOINT_RECORDS) + 1;
+            proof.valid = true;
+            WarrantyRecord record;
+            for (uint32_t i = first; i <= size() && proof.valid; i++) {
+                proof.valid = readRecord(i, record) && record.previousHash == expected;
+                expected = record.computeHash();
+                proof.valid = proof.valid && expected == record.hash && expected == hashes[i - 1];
+                proof.hashes++;
+            }
+        }
+        return true;
+    }
+
+    // Re-reads the whole ledger and checks every record's hash, every chain
+    // link and every checkpoint root. Threads take blocks in turn, each
+    // through its own file handle.
+    WarrantyAudit audit(unsigned threadCount) {
+        lock_guard<mutex> guard(lock);
+        WarrantyAudit result;
+        auto start = chrono::steady_clock::now();
+        if (!open()) {
+            result.firstBadRecord = 1;
+            return result;
+        }
+        result.records = size();
+        result.blocks = (result.records + WARRANTY_CHECKPOINT_RECORDS - 1) / WARRANTY_CHECKPOINT_RECORDS;
+        result.threads = max(1u, min<unsigned>(threadCount, static_cast<unsigned>(max<size_t>(result.blocks, 1))));
+
+        atomic<size_t> nextBlock(0);
+        atomic<uint32_t> firstBad(UINT32_MAX);
+        auto worker = [&] {
+            TRACE_SPAN("auditWorker");
+            ifstream in(dataPath, ios::binary);
+            vector<WarrantyRecord> records(WARRANTY_CHECKPOINT_RECORDS + 1);
+            vector<Sha256Digest> leaves(WARRANTY_CHECKPOINT_RECORDS);
+            for (size_t block = nextBlock++; block < result.blocks; block = nextBlock++) {
+                uint32_t first = static_cast<uint32_t>(block * WARRANTY_CHECKPOINT_RECORDS) + 1;
+                uint32_t count = min<uint32_t>(static_cast<uint32_t>(WARRANTY_CHECKPOINT_RECORDS),
+                                               static_cast<uint32_t>(result.records) - first + 1);
+                // The record before the block too, for the first link
+                uint32_t from = first > 1 ? first - 1 : first;
+                size_t read = count + (first - from);
+                in.seekg(offsetOf(from));
+                uint32_t bad = 0;
+                if (!in.read(reinterpret_cast<char*>(records.data()), read * sizeof(WarrantyRecord))) {
+                    in.clear();
+                    bad = first;
+                }
+                const WarrantyRecord* blockRecords = records.data() + (first - from);
+                for (uint32_t i = 0; i < count && bad == 0; i++) {
+                    const WarrantyRecord& record = blockRecords[i];
+                    Sha256Digest previous = first + i > 1 ? (&record)[-1].hash : Sha256Digest();
+                    leaves[i] = record.computeHash();
+                    if (record.sequence != first + i || leaves[i] != record.hash || record.previousHash != previous) {
+                        bad = first + i;
+                    }
+                }
+                if (bad == 0 && block < checkpoints.size()) {
+                    const WarrantyCheckpoint& checkpoint = checkpoints[block];
+                    if (merkleLevels(leaves.data(), count).back() != checkpoint.merkleRoot ||
+                        leaves[count - 1] != checkpoint.chainHash) {
+                        bad = first;
+                    }
+                }
+                if (bad != 0) {
+                    uint32_t seen = firstBad.load();
+                    while (bad < seen && !firstBad.compare_exchange_weak(seen, bad)) {
+                    }
+                }
+            }
+        };
+        vector<thread> workers;
+        for (unsigned i = 1; i < result.threads; i++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& t : workers) {
+            t.join();
+        }
+        result.firstBadRecord = firstBad.load() == UINT32_MAX ? 0 : firstBad.load();
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+// Indexed binary min-heap of open repair tickets, earliest due time first.
+// A ticket is its position in repairRequests; `heapPosition` maps it back to
+// its heap slot, so rescheduling or cancelling one is O(log n).
+struct RepairScheduler {
+    struct Entry {
+        int64_t dueTime;
+        size_t request;
+    };
+    vector<Entry> heap;
+    vector<int> heapPosition; // by request index; -1 when not queued
+
+    size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+    size_t top() const { return heap.front().request; }
+
+    bool contains(size_t request) const {
+        return request < heapPosition.size() && heapPosition[request] >= 0;
+    }
+
+    void clear() {
+        heap.clear();
+        heapPosition.clear();
+    }
+
+    // Queues a ticket, or moves it if it is already queued
+    void schedule(size_t request, int64_t dueTime) {
+        if (contains(request)) {
+            reprioritize(request, dueTime);
+            return;
+        }
+        if (request >= heapPosition.size()) {
+            heapPosition.resize(request + 1, -1);
+        }
+        heap.push_back({dueTime, request});
+        heapPosition[request] = static_cast<int>(heap.size() - 1);
+        siftUp(heap.size() - 1);
+    }
+
+    bool reprioritize(size_t request, int64_t dueTime) {
+        if (!contains(request)) {
+            return false;
+        }
+        size_t i = heapPosition[request];
+        heap[i].dueTime = dueTime;
+        siftUp(i);
+        siftDown(heapPosition[request]);
+        return true;
+    }
+
+    bool cancel(size_t request) {
+        if (!contains(request)) {
+            return false;
+        }
+        size_t i = heapPosition[request];
+        heapPosition[request] = -1;
+        Entry last = heap.back();
+        heap.pop_back();
+        if (i < heap.size()) {
+            place(i, last);
+            siftUp(i);
+            siftDown(heapPosition[last.request]);
+        }
+        return true;
+    }
+
+    size_t pop() {
+        size_t request = top();
+        cancel(request);
+        return request;
+    }
+
+    bool before(const Entry& a, const Entry& b) const {
+        return a.dueTime != b.dueTime ? a.dueTime < b.dueTime : a.request < b.request;
+    }
+
+    void place(size_t i, const Entry& entry) {
+        heap[i] = entry;
+        heapPosition[entry.request] = static_cast<int>(i);
+    }
+
+    void siftUp(size_t i) {
+        Entry entry = heap[i];
+        while (i > 0 && before(entry, heap[(i - 1) / 2])) {
+            place(i, heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, entry);
+    }
+
+    void siftDown(size_t i) {
+        Entry entry = heap[i];
+        while (true) {
+            size_t child = 2 * i + 1;
+            if (child >= heap.size()) {
+                break;
+            }
+            if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) {
+                child++;
+            }
+            if (!before(heap[child], entry)) {
+                break;
+            }
+            place(i, heap[child]);
+            i = child;
+        }
+        place(i, entry);
+    }
+
+    // Visits queued tickets in scheduling order without copying or changing
+    // the heap: a frontier of heap slots, smallest first, grows by each
+    // visited slot's children
+    template <typename Visit>
+    void forEachInOrder(Visit visit) const {
+        auto later = [this](size_t a, size_t b) { return before(heap[b], heap[a]); };
+        vector<size_t> frontier;
+        if (!heap.empty()) {
+            frontier.push_back(0);
+        }
+        while (!frontier.empty()) {
+            pop_heap(frontier.begin(), frontier.end(), later);
+            size_t i = frontier.back();
+            frontier.pop_back();
+            visit(heap[i].request);
+            for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < heap.size(); child++) {
+                frontier.push_back(child);
+                push_heap(frontier.begin(), frontier.end(), later);
+            }
+        }
+    }
+};
+
+// Technicians bucketed by expertise level, each bucket ordered by current
+// load (open tickets assigned to them). Finding the nearest-expertise,
+// least-loaded technician is one ordered-map lookup instead of a scan and
+// sort of every user.
+struct TechnicianRegistry {
+    struct Technician {
+        int expertise = 0; // 0: not taking repairs, but load is still tracked
+        int load = 0;
+    };
+    unordered_map<string, Technician> technicians;
+    map<int, set<pair<int, string>>> byExpertise; // expertise -> (load, username)
+
+    void clear() {
+        technicians.clear();
+        byExpertise.clear();
+    }
+
+    void link(const string& username, const Technician& tech) {
+        if (tech.expertise > 0) {
+            byExpertise[tech.expertise].insert({tech.load, username});
+        }
+    }
+
+    void unlink(const string& username, const Technician& tech) {
+        auto bucket = byExpertise.find(tech.expertise);
+        if (tech.expertise > 0 && bucket != byExpertise.end()) {
+            bucket->second.erase({tech.load, username});
+            if (bucket->second.empty()) {
+                byExpertise.erase(bucket);
+            }
+        }
+    }
+
+    void setExpertise(const string& username, int expertise) {
+        Technician& tech = technicians[username];
+        unlink(username, tech);
+        tech.expertise = max(expertise, 0);
+        link(username, tech);
+    }
+
+    void adjustLoad(const string& username, int delta) {
+        Technician& tech = technicians[username];
+        unlink(username, tech);
+        tech.load = max(tech.load + delta, 0);
+        link(username, tech);
+    }
+
+    // Closest expertise to the complexity; on an equal gap above and below,
+    // the less loaded bucket head wins, then the more expert one.
+    // Returns "" when nobody is taking repairs.
+    string pick(int complexity) const {
+        if (byExpertise.empty()) {
+            return "";
+        }
+        auto above = byExpertise.lower_bound(complexity);
+        auto best = above;
+        if (above == byExpertise.end()) {
+            best = prev(above);
+        } else if (above != byExpertise.begin()) {
+            auto below = prev(above);
+            int belowGap = complexity - below->first;
+            int aboveGap = above->first - complexity;
+            if (belowGap < aboveGap ||
+                (belowGap == aboveGap && below->second.begin()->first < above->second.begin()->first)) {
+                best = below;
+            }
+        }
+        return best->second.begin()->second;
+    }
+};
+
+struct MailMessage {
+    string to;
+    string subject;
+    string body;
+    int attempts = 0;
+    chrono::steady_clock::time_point notBefore; // earliest retry
+};
+
+// Delivery backend for the mail queue. send() gets a batch in order and
+// returns how many leading messages were delivered; the rest are retried.
+struct MailTransport {
+    virtual ~MailTransport() {}
+    virtual size_t send(const vector<MailMessage>& batch) = 0;
+};
+
+// Appends each message to a local outbox file, mbox style
+struct FileMailTransport : MailTransport {
+    string path;
+
+    explicit FileMailTransport(const string& outboxPath) : path(outboxPath) {}
+
+    size_t send(const vector<MailMessage>& batch) override {
+        ofstream out(path, ios::app);
+        if (!out) {
+            return 0;
+        }
+        time_t now = time(nullptr);
+        for (const auto& message : batch) {
+            out << "From tip-shop " << ctime(&now) << "To: " << message.to << "\nSubject: " << message.subject
+                << "\n\n" << message.body << "\n\n";
+        }
+        out.flush();
+        return out ? batch.size() : 0;
+    }
+};
+
+// Keeps delivered mail in memory. `delayMs` stands in for a network round
+// trip and `failuresLeft` rejects that many batches, for exercising retries.
+struct LoopbackMailTransport : MailTransport {
+    mutex lock;
+    vector<MailMessage> delivered;
+    int delayMs = 0;
+    int failuresLeft = 0;
+
+    size_t send(const vector<MailMessage>& batch) override {
+        if (delayMs > 0) {
+            this_thread::sleep_for(chrono::milliseconds(delayMs));
+        }
+        lock_guard<mutex> guard(lock);
+        if (failuresLeft > 0) {
+            failuresLeft--;
+            return 0;
+        }
+        delivered.insert(delivered.end(), batch.begin(), batch.end());
+        return batch.size();
+    }
+};
+
+// Bounded multi-producer, single-consumer ring. Each slot carries a sequence
+// number (Vyukov's scheme), so producers claim slots with one CAS and never
+// wait on the consumer; push() fails instead when the ring is full.
+template <typename T>
+struct MpscRing {
+    struct Slot {
+        atomic<size_t> sequence;
+        T value;
+    };
+    vector<Slot> slots;
+    size_t mask;
+    atomic<size_t> head; // next slot to claim
+    size_t tail = 0;     // consumer only
+
+    explicit MpscRing(size_t capacity) : slots(capacity), mask(capacity - 1), head(0) {
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    bool push(T&& value) {
+        size_t pos = head.load(memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(slot.sequence.load(memory_order_acquire)) -
+                            static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    slot.value = move(value);
+                    slot.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T& out) {
+        Slot& slot = slots[tail & mask];
+        if (slot.sequence.load(memory_order_acquire) != tail + 1) {
+            return false;
+        }
+        out = move(slot.value);
+        slot.sequence.store(tail + mask + 1, memory_order_release);
+        tail++;
+        return true;
+    }
+};
+
+// Background mail delivery. enqueue() only copies the message into the ring,
+// so checkout and repair desks never wait on the transport; a worker thread
+// sends in batches and retries failures with exponential backoff.
+struct MailQueue {
+    MpscRing<MailMessage> ring{MAIL_QUEUE_CAPACITY};
+    unique_ptr<MailTransport> transport;
+    thread worker;
+    mutex wakeLock;
+    condition_variable wake;
+    atomic<bool> stopping{false};
+    atomic<bool> accepting{false}; // enqueue() only pushes while the worker runs
+    atomic<size_t> enqueuing{0};   // enqueue() calls between their `accepting` check and push
+    atomic<bool> pending{false};   // set by enqueue(), cleared by the worker before it drains the ring
+    atomic<size_t> sent{0};
+    atomic<size_t> retried{0};
+    atomic<size_t> dropped{0};  // gave up after MAIL_MAX_ATTEMPTS, or undelivered at shutdown
+    atomic<size_t> rejected{0}; // ring full at enqueue
+    vector<MailMessage> retries; // worker only
+
+    ~MailQueue() { stop(); }
+
+    void start(unique_ptr<MailTransport> backend) {
+        stop();
+        transport = move(backend);
+        stopping = false;
+        worker = thread([this] { run(); });
+        accepting = true;
+    }
+
+    bool enqueue(const string& to, const string& subject, const string& body) {
+        // Registering before the `accepting` check lets stop() wait out every
+        // push that saw the queue open, so none lands after the worker's last drain
+        enqueuing++;
+        bool queued = accepting.load() && ring.push({to, subject, body, 0, {}});
+        enqueuing--;
+        if (!queued) {
+            rejected++;
+            return false;
+        }
+        // Taking the lock orders this against the worker's check of
+        // `pending`, so the wakeup cannot fall between check and wait
+        pending = true;
+        {
+            lock_guard<mutex> guard(wakeLock);
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    // Delivers what is queued (one attempt each, ignoring backoff) and stops
+    void stop() {
+        if (!worker.joinable()) {
+            return;
+        }
+        accepting = false;
+        while (enqueuing.load() > 0) {
+            this_thread::yield();
+        }
+        {
+            lock_guard<mutex> guard(wakeLock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void deliver(vector<MailMessage>& batch, bool finalAttempt) {
+        TRACE_FUNCTION();
+        size_t delivered = min(transport->send(batch), batch.size());
+        sent += delivered;
+        auto now = chrono::steady_clock::now();
+        for (size_t i = delivered; i < batch.size(); i++) {
+            MailMessage& message = batch[i];
+            if (finalAttempt || ++message.attempts >= MAIL_MAX_ATTEMPTS) {
+                dropped++;
+                continue;
+            }
+            retried++;
+            message.notBefore = now + chrono::milliseconds(MAIL_RETRY_BASE_MS << (message.attempts - 1));
+            retries.push_back(move(message));
+        }
+        batch.clear();
+    }
+
+    void run() {
+        vector<MailMessage> batch;
+        batch.reserve(MAIL_BATCH_SIZE);
+        MailMessage message;
+        while (true) {
+            pending = false;
+            // Read before draining: once `stopping` is seen every push is in
+            // the ring, so an empty drain after it really is the end
+            bool finishing = stopping.load();
+            while (batch.size() < MAIL_BATCH_SIZE && ring.pop(message)) {
+                batch.push_back(move(message));
+            }
+            auto now = chrono::steady_clock::now();
+            auto nextRetry = now + chrono::milliseconds(MAIL_IDLE_WAIT_MS);
+            for (size_t i = 0; i < retries.size();) {
+                if ((finishing || retries[i].notBefore <= now) && batch.size() < MAIL_BATCH_SIZE) {
+                    batch.push_back(move(retries[i]));
+                    retries[i] = move(retries.back());
+                    retries.pop_back();
+                } else {
+                    nextRetry = min(nextRetry, retries[i].notBefore);
+                    i++;
+                }
+            }
+
+            if (!batch.empty()) {
+                deliver(batch, finishing);
+            } else if (finishing) {
+                return;
+            } else {
+                unique_lock<mutex> guard(wakeLock);
+                wake.wait_until(guard, nextRetry, [this] { return stopping.load() || pending.load(); });
+            }
+        }
+    }
+};
+
+// Units held for a checkout between item selection and payment
+struct CheckoutReservation {
+    int sku = 0;
+    int quantity = 0;
+    bool active = false;
+};
+
+// Outcome of assignQueuedRepairsParallel()
+struct BatchAssignStats {
+    size_t assigned = 0;
+    unsigned threads = 1;
+    size_t steals = 0;  // groups taken from another worker's deque
+    double seconds = 0; // compute and commit together
+};
+
+enum SaleStatus {
+    SALE_OK,
+    SALE_UNKNOWN_ITEM,
+    SALE_OUT_OF_STOCK,
+    SALE_INSUFFICIENT_PAYMENT
+};
+
+// Result of a one-shot sale through sellItem()
+struct SaleOutcome {
+    SaleStatus status = SALE_OK;
+    int price = 0;
+    int change = 0;
+    int receiptId = 0;
+};
+
+// Time as seen by the simulated services. With virtual time the clock only
+// moves when the scheduler jumps it to the next deadline, so a scripted run
+// never waits.
+struct ServiceClock {
+    bool virtualTime = false;
+    int64_t virtualMs = 0;
+
+    int64_t nowMs() const {
+        if (virtualTime) {
+            return virtualMs;
+        }
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+// Hashed timer wheel: a timer goes in the slot for its deadline tick, and a
+// slot is only looked at when the wheel passes that tick. Timers more than
+// one turn out share a slot with nearer ones and are skipped until due.
+struct TimerWheel {
+    struct Timer {
+        uint64_t id;
+        int64_t deadlineTick;
+        function<void()> done;
+    };
+    vector<vector<Timer>> slots = vector<vector<Timer>>(TIMER_WHEEL_SLOTS);
+    int64_t currentTick = -1; // every tick up to here has been processed
+    size_t pending = 0;
+
+    void add(uint64_t id, int64_t deadlineTick, function<void()> done) {
+        deadlineTick = max(deadlineTick, currentTick + 1);
+        slots[deadlineTick % TIMER_WHEEL_SLOTS].push_back({id, deadlineTick, move(done)});
+        pending++;
+    }
+
+    // Moves every timer due by `tick` into `due`, in deadline order
+    void advance(int64_t tick, vector<Timer>& due) {
+        // One turn visits every slot, however far the clock jumped
+        int64_t last = min<int64_t>(tick, currentTick + TIMER_WHEEL_SLOTS);
+        for (int64_t t = currentTick + 1; t <= last && pending > 0; t++) {
+            vector<Timer>& slot = slots[t % TIMER_WHEEL_SLOTS];
+            for (size_t i = 0; i < slot.size();) {
+                if (slot[i].deadlineTick <= tick) {
+                    due.push_back(move(slot[i]));
+                    slot[i] = move(slot.back());
+                    slot.pop_back();
+                    pending--;
+                } else {
+                    i++;
+                }
+            }
+        }
+        currentTick = max(currentTick, tick);
+        sort(due.begin(), due.end(), [](const Timer& a, const Timer& b) {
+            return a.deadlineTick != b.deadlineTick ? a.deadlineTick < b.deadlineTick : a.id < b.id;
+        });
+    }
+
+    int64_t nextDeadlineTick() const {
+        int64_t next = numeric_limits<int64_t>::max();
+        for (const auto& slot : slots) {
+            for (const auto& timer : slot) {
+                next = min(next, timer.deadlineTick);
+            }
+        }
+        return next;
+    }
+};
+
+// Completions for the simulated services, run on the main thread. Due
+// timers run whenever the menu comes round (runDue) or while a service
+// waits on a step it needs (runNext).
+struct ServiceScheduler {
+    ServiceClock clock;
+    TimerWheel wheel;
+    uint64_t nextId = 1;
+
+    static int64_t tickOf(int64_t ms) { return ms / SERVICE_TICK_MS; }
+
+    void after(chrono::milliseconds delay, function<void()> done) {
+        int64_t now = clock.nowMs();
+        if (wheel.currentTick < 0) {
+            wheel.currentTick = tickOf(now);
+        }
+        // Rounded up, so a completion never runs early
+        wheel.add(nextId++, tickOf(now + delay.count() + SERVICE_TICK_MS - 1), move(done));
+    }
+
+    size_t runDue() {
+        vector<TimerWheel::Timer> due;
+        wheel.advance(tickOf(clock.nowMs()), due);
+        for (auto& timer : due) {
+            timer.done();
+        }
+        return due.size();
+    }
+
+    // Waits for the next deadline (a jump, with virtual time) and runs what
+    // is due by then
+    void runNext() {
+        if (wheel.pending == 0) {
+            return;
+        }
+        int64_t deadlineMs = wheel.nextDeadlineTick() * SERVICE_TICK_MS;
+        if (clock.virtualTime) {
+            clock.virtualMs = max(clock.virtualMs, deadlineMs);
+        } else if (deadlineMs > clock.nowMs()) {
+            this_thread::sleep_for(chrono::milliseconds(deadlineMs - clock.nowMs()));
+        }
+        runDue();
+    }
+
+    // Runs what is due at a menu. With virtual time nobody is waiting at
+    // the menu, so everything scheduled so far finishes there.
+    void catchUp() {
+        if (!clock.virtualTime) {
+            runDue();
+        }
+        while (clock.virtualTime && wheel.pending > 0) {
+            runNext();
+        }
+    }
+};
+
+enum DeviceType {
+    DEVICE_SMARTPHONE,
+    DEVICE_LAPTOP,
+    DEVICE_SMART_HOME,
+    DEVICE_OTHER,
+    DEVICE_TYPE_COUNT
+};
+
+const char* const DEVICE_TYPE_NAMES[DEVICE_TYPE_COUNT] = {"Smartphone", "Laptop", "Smart Home Device", "Other"};
+const char* const DIAGNOSTIC_ISSUES[] = {"Software update required", "Battery health degraded",
+                                         "Storage space low", "Network connectivity issues"};
+const size_t DIAGNOSTIC_ISSUE_COUNT = sizeof(DIAGNOSTIC_ISSUES) / sizeof(DIAGNOSTIC_ISSUES[0]);
+
+struct DiagnosticResult {
+    size_t device = 0;        // position in the cart
+    DeviceType type = DEVICE_OTHER;
+    uint8_t issues = 0;       // bit per DIAGNOSTIC_ISSUES entry
+    int64_t elapsedMs = 0;    // service clock time since the run started
+    int repairRequest = -1;   // filed for a device with issues
+};
+
+// Remote diagnostic sessions for a cart of devices, up to `concurrency` at
+// a time. A session is two scheduled steps (connect, then system checks)
+// on the service scheduler, so sessions overlap without threads; as one
+// finishes the next device starts. Results arrive in completion order.
+struct DiagnosticsRun {
+    vector<DeviceType> devices;
+    size_t concurrency = 1;
+    function<void(const DiagnosticResult&)> onResult;
+    mt19937 gen{random_device{}()};
+    size_t started = 0;
+    size_t finished = 0;
+    int64_t startMs = 0;
+
+    bool done() const { return finished == devices.size(); }
+
+    // Steps take between three quarters and one and a quarter of the
+    // nominal time, so sessions drift apart as they would on real devices
+    chrono::milliseconds stepTime(int64_t nominalMs) {
+        return chrono::milliseconds(uniform_int_distribution<int64_t>(nominalMs * 3 / 4, nominalMs * 5 / 4)(gen));
+    }
+
+    void start(ServiceScheduler& scheduler) {
+        startMs = scheduler.clock.nowMs();
+        while (started < devices.size() && started < max<size_t>(concurrency, 1)) {
+            launch(scheduler);
+        }
+    }
+
+    void launch(ServiceScheduler& scheduler) {
+        size_t device = started++;
+        chrono::milliseconds checks = stepTime(DIAGNOSTIC_CHECKS_MS);
+        scheduler.after(stepTime(DIAGNOSTIC_CONNECT_MS), [this, &scheduler, device, checks] {
+            scheduler.after(checks, [this, &scheduler, device] { complete(scheduler, device); });
+        });
+    }
+
+    void complete(ServiceScheduler& scheduler, size_t device);
+};
+
+// Global variables
+vector<Item> inventory;
+vector<RepairRequest> repairRequests;
+TransactionStore transactions;
+ReceiptArchive receiptArchive(RECEIPT_ARCHIVE_FILE, RECEIPT_INDEX_FILE);
+WarrantyLedger warrantyLedger(WARRANTY_LEDGER_FILE, WARRANTY_CHECKPOINT_FILE);
+const ReceiptTemplate receiptTemplate;
+vector<char> receiptArena; // reused by bulk renders
+map<string, User> users;
+RepairScheduler repairQueue;
+StatusBuckets<REPAIR_STATUS_COUNT> repairsByStatus;
+StatusBuckets<PRINT_STATUS_COUNT> printJobsByStatus;
+TechnicianRegistry technicians;
+MailQueue mailQueue;
+ServiceScheduler serviceScheduler;
+vector<string> serviceNotices; // finished background services, shown on the menu
+vector<PrintJob> printJobs;
+RecyclingStore recyclingRecords;
+InventoryIndex inventoryIndex;
+int nextSku = 1;
+TerminalRenderer terminal;
+
+// Checkout concurrency: stock and reservations are guarded by a lock stripe
+// chosen by SKU, recording a sale by salesMutex, and the inventory vector
+// itself (which can reallocate) by inventoryMutex. Lock order is
+// inventoryMutex, then a stripe or salesMutex.
+mutex stockLocks[STOCK_LOCK_STRIPES];
+mutex salesMutex;
+shared_mutex inventoryMutex;
+
+// Transaction history from the last snapshot stays mapped and is only decoded
+// the first time a report or save needs it, so boot time does not depend on it.
+MappedFile snapshotMapping;
+bool transactionHistoryPending = false;
+JournalState journal;
+
+// Function prototypes
+void clearScreen();
+void pause();
+bool verifyStudentID();
+void displayItems(const vector<Item>& items);
+void displayItems(const pmr::vector<int>& positions);
+void adminAddNewItem();
+void adminAddStock();
+void buyItem(User& currentUser);
+void submitRepairRequest();
+void viewRepairRequests();
+void viewReceipts(const User& currentUser);
+void updateRepairStatus();
+void displaySalesReport();
+void displayInventoryStatus();
+void displayPopularItems();
+void searchItems();
+pmr::vector<int> findMatchingItems(const string& term);
+struct SearchHit;
+pmr::vector<SearchHit> searchInventoryText(const string& query);
+void redeemLoyaltyPoints(User& currentUser);
+void saveDataToFile();
+void loadDataFromFile();
+bool mapFile(const char* path, MappedFile& file);
+void unmapFile(MappedFile& file);
+bool saveSnapshot(const char* path);
+bool loadSnapshot(const char* path, uint64_t& journalSequence);
+void ensureTransactionHistoryLoaded();
+bool exportDataToText(const string& path);
+bool importDataFromText(const string& path);
+void adminExportData();
+bool adminImportData();
+string normalizeText(const string& text);
+RepairStatus loadRepairStatus(const string& text);
+bool parseRepairStatus(const string& text, RepairStatus& status);
+bool parsePrintStatus(const string& text, PrintStatus& status);
+ItemCategory categoryOf(const string& category);
+void indexInventoryItem(size_t position);
+void rebuildInventoryIndex();
+size_t addInventoryItem(const Item& item);
+Item* findItemBySku(int sku);
+Item* findItemByName(const string& name);
+struct JournalReader;
+bool openJournal();
+void closeJournal();
+void syncJournal();
+void syncJournalLocked();
+void appendJournalRecord(JournalRecordType type, const string& payload);
+void journalSale(const Item& item, const Transaction& trans, const User& user);
+void journalStockChange(const Item& item, int delta);
+void journalNewItem(const Item& item);
+void journalRepairAdded(const RepairRequest& req);
+void journalRepairStatus(size_t requestIndex);
+void journalRepairAssigned(size_t requestIndex);
+void journalRepairPriority(size_t requestIndex);
+void journalUserRegistered(const User& user);
+void journalLoyaltyPoints(const User& user);
+void journalTechnicianExpertise(const User& user);
+bool applyJournalRecord(JournalRecordType type, JournalReader& in);
+size_t replayJournal(uint64_t snapshotSequence);
+bool compactJournal();
+void maybeCompactJournal();
+mutex& stockLockFor(int sku);
+int availableStock(const Item& item);
+bool reserveStock(int sku, int quantity, CheckoutReservation& reservation);
+void abortReservation(CheckoutReservation& reservation);
+bool commitReservation(CheckoutReservation& reservation, int unitPrice, User& customer);
+bool runCheckoutStressTest(int maxThreads);
+float checkoutPrice(const Item& item, bool studentDiscount);
+SaleOutcome sellItem(int sku, int payment, bool studentDiscount, User& customer);
+bool restockItem(int sku, int quantity);
+size_t createItem(const Item& item);
+int validServiceTier(int serviceTier);
+int64_t repairDueTime(const RepairRequest& req);
+bool isRepairOpen(const RepairRequest& req);
+void rebuildRepairQueue();
+void rebuildTechnicianRegistry();
+bool setTechnicianExpertise(const string& username, int expertise);
+int assignNextRepair();
+size_t assignQueuedRepairs();
+BatchAssignStats assignQueuedRepairsParallel(unsigned threadCount);
+size_t recordRepairRequest(const string& itemName, const string& issue, int complexity, int serviceTier);
+bool rescheduleRepair(size_t requestIndex, int complexity, int serviceTier);
+bool setRepairStatus(size_t requestIndex, RepairStatus status);
+void rebuildRepairStatusIndex();
+bool setPrintJobStatus(size_t jobIndex, PrintStatus status);
+string formatStatusCounts(const string* names, const size_t* counts, size_t states);
+bool createUser(const string& username, const string& password, bool isStudent);
+string batchRemainder(istringstream& args);
+int issueReceipt(const Item& item, int price, int payment, const User& customer);
+bool findReceipt(int receiptId, Receipt& receipt);
+string renderReceipt(const Receipt& receipt);
+size_t renderReceipts(const Receipt* first, size_t count, vector<char>& arena, size_t at = 0);
+time_t localDayStart(time_t when);
+bool parseDate(const string& text, time_t& dayStart);
+bool queueDailyReceiptDigest(const string& to, time_t day, size_t& receiptCount);
+bool queueMail(const string& to, const string& subject, const string& body);
+bool queueRepairConfirmation(const string& to, size_t requestIndex);
+string promptEmailAddress(const string& prompt);
+void runServiceStep(chrono::milliseconds duration);
+void finishServiceInBackground(chrono::milliseconds duration, const string& notice);
+void showServiceNotices();
+bool runBatch(istream& in);
+void registerUser();
+User* loginUser();
+void offerTradeIn(User& currentUser);
+void conductVirtualRepairSession();
+void schedulePickupDelivery();
+void displayUserDashboard(const User& user);
+void generateQRCode(const string& data);
+void simulateIoTDeviceRepair();
+void applyAugmentedRealityRepair();
+void offerSubscriptionService();
+void provideRepairEstimate();
+void offerRemoteDiagnostics();
+uint8_t drawDiagnosticIssues(mt19937& gen);
+string describeDiagnosticIssues(uint8_t issues);
+void runDiagnostics(DiagnosticsRun& run);
+void diagnoseDeviceCart();
+string formatDate(time_t timestamp);
+void printWarrantyAudit(const WarrantyAudit& audit);
+string formatMicros(uint64_t ns);
+void printOperationStats(ostream& out);
+void displayOperationStats();
+void dumpOperationStats();
+void maybeDumpOperationStats();
+bool startTracing();
+size_t stopTracing();
+void flushTrace();
+void toggleTracing();
+void gamifyLoyaltyProgram(User& currentUser);
+void displayRepairQueue();
+void assignRepairTechnician();
+void submit3DPrintJob();
+void update3DPrintStatus();
+void displayRecyclingStats();
+void manageInventoryAlerts();
+void implementBlockchainWarranty();
+
+// Function implementations
+void clearScreen() {
+    if (terminal.target) {
+        terminal.beginFrame();
+        return;
+    }
+    #ifdef _WIN32
+        system("cls");
+    #endif
+}
+
+void pause() {
+    TRACE_SPAN("waitForInput");
+    cout << "Press Enter to continue...";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cin.get();
+}
+
+bool verifyStudentID() {
+    TRACE_FUNCTION();
+    int studentID;
+    cout << "Enter your 7-digit school ID (starting from 2000000): ";
+    {
+        TRACE_SPAN("waitForInput");
+        WAITING_FOR_INPUT();
+        cin >> studentID;
+    }
+
+    if (cin.fail()) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number.\n";
+        return false;
+    }
+
+    if (studentID >= 2000000 && studentID <= 2999999) {
+        cout << "Student ID verified successfully. You are eligible for the student discount.\n";
+        return true;
+    } else {
+        cout << "Invalid ID! You are not eligible for the student discount.\n";
+        return false;
+    }
+}
+
+// On a terminal, long tables stop after each screenful; otherwise the whole
+// table goes out at once. Like pause(), the reply is left in cin (minus a
+// 'q') so the caller's next read behaves as if no pager had run.
+void TableWriter::print() {
+    size_t pageRows = rowEnds.size();
+    if (terminal.target) {
+        terminal.refreshScreenSize();
+        pageRows = terminal.screenRows > 12 ? terminal.screenRows - 8 : 4;
+    }
+
+    size_t row = 0;
+    while (true) {
+        size_t last = min(row + pageRows, rowEnds.size());
+        size_t from = row == 0 ? 0 : rowEnds[row - 1];
+        size_t to = last == 0 ? 0 : rowEnds[last - 1];
+        cout.write(header.data(), header.size());
+        cout.write(body.data() + from, to - from);
+        row = last;
+        if (row >= rowEnds.size()) {
+            break;
+        }
+        cout << "-- " << row << " of " << rowEnds.size() << " rows; Enter for more, q to stop -- " << flush;
+        int reply;
+        {
+            WAITING_FOR_INPUT();
+            TRACE_SPAN("waitForInput");
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            reply = cin.peek();
+        }
+        if (reply == EOF) {
+            break;
+        }
+        if (reply == 'q' || reply == 'Q') {
+            cin.get();
+            break;
+        }
+        clearScreen();
+    }
+    cout.flush();
+}
+
+TableWriter itemTable(size_t rows) {
+    return TableWriter({{"No.", 5}, {"SKU", 8}, {"Name", 25}, {"Condition", 25},
+                        {"Price", 10}, {"Stock", 10}, {"Category", 15}}, rows);
+}
+
+void addItemRow(TableWriter& table, size_t number, const Item& item) {
+    table.cell(number);
+    table.cell(item.sku);
+    table.cell(item.name);
+    table.cell(item.condition);
+    table.cell(item.price);
+    table.cell(item.stock);
+    table.cell(item.category);
+    table.endRow();
+}
+
+void displayItems(const vector<Item>& items) {
+    TRACE_FUNCTION();
+    TableWriter table = itemTable(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        addItemRow(table, i + 1, items[i]);
+    }
+    table.print();
+}
+
+// Inventory rows by position, as returned by a search
+void displayItems(const pmr::vector<int>& positions) {
+    TRACE_FUNCTION();
+    TableWriter table = itemTable(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        addItemRow(table, i + 1, inventory[positions[i]]);
+    }
+    table.print();
+}
+
+void adminAddNewItem() {
+    TRACE_FUNCTION();
+    Item newItem;
+    clearScreen();
+    cout << "\n--- Admin: Add New Item ---" << endl;
+    cout << "Enter item name: ";
+    cin.ignore();
+    getline(cin, newItem.name);
+    string condition, category;
+    cout << "Enter item condition: ";
+    getline(cin, condition);
+    newItem.condition = condition;
+    cout << "Enter item price: ";
+    cin >> newItem.price;
+    cout << "Enter initial stock: ";
+    cin >> newItem.stock;
+    cout << "Enter category (Electronics/Furniture/Gadgets): ";
+    cin.ignore();
+    getline(cin, category);
+    newItem.category = category;
+
+    size_t position = createItem(newItem);
+    cout << "New item added successfully! SKU: " << inventory[position].sku << endl;
+    pause();
+}
+
+void adminAddStock() {
+    TRACE_FUNCTION();
+    int choice, additionalStock;
+    clearScreen();
+    cout << "\n--- Admin: Add Stock ---" << endl;
+    displayItems(inventory);
+    cout << "Enter the item number to add stock (0 to cancel): ";
+    cin >> choice;
+
+    if (cin.fail()) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number.\n";
+        pause();
+        return;
+    }
+
+    if (choice > 0 && choice <= static_cast<int>(inventory.size())) {
+        cout << "Enter the amount of stock to add: ";
+        cin >> additionalStock;
+
+        if (cin.fail() || additionalStock < 0) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please enter a positive number.\n";
+        } else {
+            restockItem(inventory[choice - 1].sku, additionalStock);
+            cout << "Stock updated. New stock for " << inventory[choice - 1].name << ": " << inventory[choice - 1].stock << endl;
+        }
+    } else if (choice != 0) {
+        cout << "Invalid choice!" << endl;
+    }
+    pause();
+}
+
+void buyItem(User& currentUser) {
+    TRACE_FUNCTION();
+    int choice;
+    clearScreen();
+    cout << "Select an item to buy: " << endl;
+    displayItems(inventory);
+    cout << "Enter your choice (0 to cancel): ";
+    {
+        TRACE_SPAN("waitForInput");
+        cin >> choice;
+    }
+
+    if (cin.fail()) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number.\n";
+        pause();
+        return;
+    }
+
+    // Timed from the item choice through commit or rejection, less the
+    // student ID and payment prompts
+    MEASURE_OPERATION(OP_BUY_ITEM);
+    // The unit is held while the customer pays, so another counter cannot
+    // sell it in the meantime; every exit below commits or releases it.
+    CheckoutReservation reservation;
+    if (choice > 0 && choice <= static_cast<int>(inventory.size()) &&
+        reserveStock(inventory[choice - 1].sku, 1, reservation)) {
+        int payment;
+        bool discounted = currentUser.isStudent && verifyStudentID();
+        float price = checkoutPrice(inventory[choice - 1], discounted);
+
+        if (discounted) {
+            cout << "Discounted Price: P" << price << endl;
+        } else {
+            cout << "Total Price: P" << price << endl;
+        }
+
+        cout << "Enter payment amount: P";
+        {
+            TRACE_SPAN("waitForInput");
+            WAITING_FOR_INPUT();
+            cin >> payment;
+        }
+
+        if (cin.fail()) {
+            abortReservation(reservation);
+            END_OPERATION();
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please enter a number.\n";
+            pause();
+            return;
+        }
+
+        if (payment >= price) {
+            int change = payment - price;
+            cout << "Payment successful. Change: P" << change << endl;
+
+            commitReservation(reservation, static_cast<int>(price), currentUser);
+            cout << "You earned " << POINTS_PER_PURCHASE << " loyalty points!" << endl;
+
+            Receipt issued;
+            int receiptId = issueReceipt(inventory[choice - 1], static_cast<int>(price), payment, currentUser);
+            string receipt = findReceipt(receiptId, issued) ? renderReceipt(issued) : string();
+            cout << "\n" << receipt << endl;
+            END_OPERATION();
+            string email = promptEmailAddress("Email a copy of the receipt to (blank to skip): ");
+            if (!email.empty()) {
+                cout << (queueMail(email, "Your T.I.P. Shop receipt", receipt) ? "Receipt will be emailed to "
+                                                                                  : "Could not queue email to ")
+                     << email << endl;
+            }
+        } else {
+            abortReservation(reservation);
+            cout << "Insufficient payment. Transaction canceled." << endl;
+        }
+    } else if (choice != 0) {
+        cout << "Invalid choice or out of stock!" << endl;
+    }
+    END_OPERATION();
+    pause();
+}
+
+void submitRepairRequest() {
+    TRACE_FUNCTION();
+    string itemName, issue;
+    clearScreen();
+    cout << "\n--- Submit a Repair Request ---" << endl;
+    cout << "Enter the name of the item: ";
+    cin.ignore();
+    getline(cin, itemName);
+    cout << "Describe the issue: ";
+    getline(cin, issue);
+    cout << "Coverage (0 = none, 1 = warranty, 2 = repair subscription): ";
+    int serviceTier;
+    cin >> serviceTier;
+    if (cin.fail()) {
+        cin.clear();
+        serviceTier = TIER_STANDARD;
+    }
+
+    size_t requestIndex = recordRepairRequest(itemName, issue, DEFAULT_REPAIR_COMPLEXITY, serviceTier);
+    cout << "Your repair request has been submitted successfully!\n" << endl;
+    string email = promptEmailAddress("Email for status updates (blank to skip): ");
+    if (!email.empty() && !queueRepairConfirmation(email, requestIndex)) {
+        cout << "Could not queue email to " << email << endl;
+    }
+    pause();
+}
+
+void viewRepairRequests() {
+    TRACE_FUNCTION();
+    clearScreen();
+    if (repairRequests.empty()) {
+        cout << "\nNo repair requests at the moment.\n" << endl;
+    } else {
+        cout << "\n--- Repair Requests ---" << endl;
+        TableWriter table({{"No.", 5}, {"Item", 20}, {"Issue", 30}, {"Status", 15}, {"Submission Time", 25}},
+                          repairRequests.size());
+        for (size_t i = 0; i < repairRequests.size(); i++) {
+            table.cell(i + 1);
+            table.cell(repairRequests[i].itemName);
+            table.cell(repairRequests[i].issue);
+            table.cell(REPAIR_STATUS_NAMES[repairRequests[i].status]);
+            table.timestampCell(repairRequests[i].submissionTime);
+            table.endRow();
+        }
+        table.print();
+
+        size_t counts[REPAIR_STATUS_COUNT];
+        for (int status = 0; status < REPAIR_STATUS_COUNT; status++) {
+            counts[status] = repairsByStatus.count(status);
+        }
+        cout << formatStatusCounts(REPAIR_STATUS_NAMES, counts, REPAIR_STATUS_COUNT) << "\n" << endl;
+    }
+    pause();
+}
+
+// Pages through the customer's receipts (everyone's for admin), newest
+// first, reading one page from the archive at a time
+void viewReceipts(const User& currentUser) {
+    TRACE_FUNCTION();
+    bool showAll = currentUser.username == "admin";
+    string customer = showAll ? string() : currentUser.username;
+    uint32_t cursor = 0;
+    vector<Receipt> page;
+    receiptArchive.page(customer, cursor, RECEIPT_PAGE_SIZE, page);
+
+    while (true) {
+        clearScreen();
+        if (page.empty()) {
+            cout << "\nNo receipts available.\n" << endl;
+            pause();
+            return;
+        }
+        cout << "\n--- Receipts ---" << endl;
+        TableWriter table({{"ID", 8}, {"Customer", 15}, {"Item", 25}, {"Price", 10}, {"Date", 25}}, page.size());
+        for (const auto& receipt : page) {
+            table.cell(receipt.id);
+            table.cell(receipt.username);
+            table.cell(receipt.itemName);
+            table.cell(receipt.price);
+            table.timestampCell(receipt.timestamp);
+            table.endRow();
+        }
+        table.print();
+
+        cout << "Enter a receipt ID to view it";
+        if (cursor != 0) {
+            cout << ", N for older receipts";
+        }
+        if (showAll) {
+            cout << ", D to jump to a date";
+        }
+        cout << " (0 to exit): ";
+        string choice;
+        cin >> choice;
+        transform(choice.begin(), choice.end(), choice.begin(), ::toupper);
+
+        if (choice == "N" && cursor != 0) {
+            receiptArchive.page(customer, cursor, RECEIPT_PAGE_SIZE, page);
+            continue;
+        }
+        if (choice == "D" && showAll) {
+            string dateText;
+            time_t dayStart;
+            cout << "Date (YYYY-MM-DD): ";
+            cin >> dateText;
+            if (parseDate(dateText, dayStart)) {
+                // Newest receipt of that day first
+                cursor = receiptArchive.firstAtOrAfter(dayStart + 86400) - 1;
+                if (cursor != 0) {
+                    receiptArchive.page(customer, cursor, RECEIPT_PAGE_SIZE, page);
+                }
+                continue;
+            }
+            cout << "Invalid date!" << endl;
+            pause();
+            continue;
+        }
+
+        int receiptId = atoi(choice.c_str());
+        Receipt receipt;
+        if (receiptId > 0 && findReceipt(receiptId, receipt) && (showAll || receipt.username == currentUser.username)) {
+            string text = renderReceipt(receipt);
+            cout << text << endl;
+            string email = promptEmailAddress("Email a copy of this receipt to (blank to skip): ");
+            if (!email.empty()) {
+                cout << (queueMail(email, "Your T.I.P. Shop receipt", text) ? "Receipt will be emailed to "
+                                                                           : "Could not queue email to ")
+                     << email << endl;
+            }
+        } else if (choice != "0") {
+            cout << "Invalid receipt ID!" << endl;
+        }
+        pause();
+        return;
+    }
+}
+
+void updateRepairStatus() {
+    TRACE_FUNCTION();
+    clearScreen();
+    if (repairRequests.empty()) {
+        cout << "\nNo repair requests to update.\n" << endl;
+    } else {
+        int choice;
+        
+        cout << "\n--- Update Repair Request Status ---" << endl;
+        viewRepairRequests();
+        
+        cout << "Enter the request number to update (0 to cancel): ";
+        cin >> choice;
+        
+        if (cin.fail()) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Invalid input. Please enter a number.\n";
+            pause();
+            return;
+        }
+        
+        if (choice > 0 && choice <= static_cast<int>(repairRequests.size())) {
+            // Offer only the moves the state machine allows from here
+            RepairStatus current = repairRequests[choice - 1].status;
+            vector<RepairStatus> options;
+            cout << "Current status: " << current << endl;
+            for (int next = 0; next < REPAIR_STATUS_COUNT; next++) {
+                if (REPAIR_TRANSITIONS[current][next] && next != REPAIR_ASSIGNED) {
+                    options.push_back(static_cast<RepairStatus>(next));
+                    cout << options.size() << ". " << REPAIR_STATUS_NAMES[next] << endl;
+                }
+            }
+            int option;
+            cout << "Choose the new status (0 to cancel): ";
+            cin >> option;
+            if (cin.fail()) {
+                cin.clear();
+                option = -1;
+            }
+
+            if (option > 0 && option <= static_cast<int>(options.size()) &&
+                setRepairStatus(choice - 1, options[option - 1])) {
+                cout << "Status updated successfully!" << endl;
+            } else if (option != 0) {
+                cout << "Invalid choice!" << endl;
+            }
+        } else if (choice != 0) {
+            cout << "Invalid choice!" << endl;
+        }
+    }
+    pause();
+}
+
+void displaySalesReport() {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_SALES_REPORT);
+    clearScreen();
+    ensureTransactionHistoryLoaded();
+    if (transactions.empty()) {
+        cout << "\nNo transactions recorded yet.\n" << endl;
+    } else {
+        cout << "\n--- Sales Report ---" << endl;
+        TableWriter table({{"No.", 5}, {"Item", 25}, {"Price", 10}, {"Timestamp", 25}}, transactions.size());
+        for (size_t i = 0; i < transactions.size(); i++) {
+            table.cell(i + 1);
+            table.cell(transactions.itemName(i));
+            table.cell(transactions.prices[i]);
+            table.timestampCell(static_cast<time_t>(transactions.timestamps[i]));
+            table.endRow();
+        }
+        table.print();
+        
+        const SalesAggregates& stats = transactions.stats;
+        int64_t today = toLocalTime(time(nullptr)) / 86400;
+        long long monthRevenue = 0;
+        for (int64_t day = today - 29; day <= today; day++) {
+            auto it = stats.byDay.find(day);
+            if (it != stats.byDay.end()) {
+                monthRevenue += it->second.revenue;
+            }
+        }
+        int busiestHour = 0;
+        for (int hour = 1; hour < 24; hour++) {
+            if (stats.byHour[hour].sales > stats.byHour[busiestHour].sales) {
+                busiestHour = hour;
+            }
+        }
+        auto todayStats = stats.byDay.find(today);
+        cout << "\nTotal Revenue: P" << stats.totalRevenue << endl;
+        cout << "Revenue (last 30 days): P" << monthRevenue << endl;
+        cout << "Today: " << (todayStats != stats.byDay.end() ? todayStats->second.sales : 0) << " sale(s), P"
+             << (todayStats != stats.byDay.end() ? todayStats->second.revenue : 0) << endl;
+        cout << "Busiest hour: " << setw(2) << setfill('0') << busiestHour << ":00" << setfill(' ')
+             << " (" << stats.byHour[busiestHour].sales << " sale(s))" << endl;
+    }
+    END_OPERATION();
+    pause();
+}
+
+void displayInventoryStatus() {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_INVENTORY_STATUS);
+    clearScreen();
+    cout << "\n--- Inventory Status ---" << endl;
+    displayItems(inventory);
+    
+    int totalItems = 0;
+    int totalValue = 0;
+    for (const auto& item : inventory) {
+        totalItems += item.stock;
+        totalValue += item.price * item.stock;
+    }
+    
+    cout << "\nTotal number of items in inventory: " << totalItems << endl;
+    cout << "Total value of inventory: P" << totalValue << endl;
+
+    cout << "\nBy category:" << endl;
+    for (int c = 0; c < CATEGORY_COUNT; c++) {
+        int categoryStock = 0;
+        for (int position : inventoryIndex.byCategory[c]) {
+            categoryStock += inventory[position].stock;
+        }
+        if (!inventoryIndex.byCategory[c].empty()) {
+            cout << setw(15) << CATEGORY_NAMES[c] << ": " << inventoryIndex.byCategory[c].size()
+                 << " SKU(s), " << categoryStock << " in stock" << endl;
+        }
+    }
+    END_OPERATION();
+    pause();
+}
+
+void displayPopularItems() {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_POPULAR_ITEMS);
+    clearScreen();
+    cout << "\n--- Popular Items ---" << endl;
+    
+    const vector<pair<uint32_t, uint32_t>>& topSales = transactions.stats.topSellers.entries;
+    
+    cout << setw(5) << "Rank" << setw(25) << "Item" << setw(10) << "Sales" << endl;
+    cout << string(40, '-') << endl;
+    
+    for (size_t i = 0; i < topSales.size(); i++) {
+        cout << setw(5) << i + 1 
+             << setw(25) << transactions.itemNames.names[topSales[i].first] 
+             << setw(10) << topSales[i].second << endl;
+    }
+    END_OPERATION();
+    pause();
+}
+
+void searchItems() {
+    TRACE_FUNCTION();
+    string searchTerm;
+    clearScreen();
+    cout << "\n--- Search Items ---" << endl;
+    cout << "Enter search term: ";
+    cin.ignore();
+    getline(cin, searchTerm);
+    
+    MEASURE_OPERATION(OP_SEARCH_ITEMS);
+    pmr::vector<int> searchResults = findMatchingItems(searchTerm);
+    if (searchResults.empty()) {
+        cout << "No items found matching your search term." << endl;
+    } else {
+        cout << "\nSearch Results:" << endl;
+        displayItems(searchResults);
+    }
+    END_OPERATION();
+    pause();
+}
+
+struct SearchHit {
+    int position;
+    int score;
+};
+
+// Edits allowed when matching a search word. Numbers such as model numbers
+// must match exactly.
+int searchEditBudget(string_view word) {
+    if (hasDigit(word) || word.size() < 4) {
+        return 0;
+    }
+    return word.size() < 8 ? 1 : 2;
+}
+
+// Items containing every word of the query, as a whole word, a word prefix
+// or a near miss, in inventory order. Scratch space and the result live in
+// the action arena.
+pmr::vector<SearchHit> searchInventoryText(const string& query) {
+    TRACE_FUNCTION();
+    const FullTextIndex& index = inventoryIndex.text;
+    pmr::memory_resource* arena = &actionArena();
+    pmr::vector<pmr::string> words(arena);
+    pmr::string token(arena);
+    forEachSearchToken(query, token, [&](const pmr::string& word) { words.push_back(word); });
+
+    pmr::vector<SearchHit> hits(arena), wordHits(arena), merged(arena);
+    pmr::vector<int> prefixed(arena);
+    pmr::vector<pair<int, int>> nearMisses(arena);
+    for (size_t w = 0; w < words.size(); w++) {
+        const pmr::string& word = words[w];
+        wordHits.clear();
+        size_t termsUsed = 0;
+        auto addTerm = [&](int term, int quality) {
+            for (const auto& posting : index.postings[term]) {
+                wordHits.push_back({posting.position, quality * searchFieldWeight(posting.fields)});
+            }
+            termsUsed++;
+        };
+
+        int exact = index.termIds.find(string_view(word));
+        if (exact >= 0) {
+            addTerm(exact, SEARCH_EXACT_SCORE);
+        }
+        prefixed.clear();
+        int node = index.findNode(word);
+        if (node >= 0) {
+            index.collectTerms(node, SEARCH_PREFIX_TERMS, prefixed);
+        }
+        for (int term : prefixed) {
+            if (term != exact) {
+                addTerm(term, SEARCH_PREFIX_SCORE);
+            }
+        }
+        int budget = searchEditBudget(word);
+        if (budget > 0) {
+            nearMisses.clear();
+            index.fuzzyTerms(word, budget, nearMisses);
+            for (const auto& [term, distance] : nearMisses) {
+                if (term != exact && index.terms[term].compare(0, word.size(), word) != 0) {
+                    addTerm(term, SEARCH_PREFIX_SCORE - distance);
+                }
+            }
+        }
+
+        // One list per term is already in inventory order; several are
+        // merged, keeping each item's best match for this word
+        if (termsUsed > 1) {
+            sort(wordHits.begin(), wordHits.end(), [](const SearchHit& a, const SearchHit& b) {
+                return a.position != b.position ? a.position < b.position : a.score > b.score;
+            });
+            wordHits.erase(unique(wordHits.begin(), wordHits.end(),
+                                  [](const SearchHit& a, const SearchHit& b) { return a.position == b.position; }),
+                           wordHits.end());
+        }
+
+        if (w == 0) {
+            hits.swap(wordHits);
+        } else {
+            merged.clear();
+            size_t a = 0, b = 0;
+            while (a < hits.size() && b < wordHits.size()) {
+                if (hits[a].position < wordHits[b].position) {
+                    a++;
+                } else if (wordHits[b].position < hits[a].position) {
+                    b++;
+                } else {
+                    merged.push_back({hits[a].position, hits[a].score + wordHits[b].score});
+                    a++;
+                    b++;
+                }
+            }
+            hits.swap(merged);
+        }
+        if (hits.empty()) {
+            break;
+        }
+    }
+    return hits;
+}
+
+// Inventory positions of matching items, best first: an item whose whole
+// name is the query, then by search score. A query that matches no words
+// falls back to matching inside names ("phone" in "Smartphone"). The list
+// lives in the action arena.
+pmr::vector<int> findMatchingItems(const string& term) {
+    TRACE_FUNCTION();
+    string searchTerm = normalizeText(term);
+
+    pmr::vector<SearchHit> hits = searchInventoryText(searchTerm);
+    for (auto& hit : hits) {
+        if (inventoryIndex.normalizedNames[hit.position] == searchTerm) {
+            hit.score += SEARCH_WHOLE_NAME_BONUS;
+        }
+    }
+    sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) {
+        return a.score != b.score ? a.score > b.score : a.position < b.position;
+    });
+
+    pmr::vector<int> searchResults(&actionArena());
+    searchResults.reserve(hits.size());
+    for (const auto& hit : hits) {
+        searchResults.push_back(hit.position);
+    }
+    if (searchResults.empty()) {
+        for (size_t i = 0; i < inventory.size(); i++) {
+            if (inventoryIndex.normalizedNames[i].find(searchTerm) != string::npos) {
+                searchResults.push_back(static_cast<int>(i));
+            }
+        }
+    }
+    return searchResults;
+}
+
+void redeemLoyaltyPoints(User& currentUser) {
+    TRACE_FUNCTION();
+    clearScreen();
+    cout << "\n--- Redeem Loyalty Points ---" << endl;
+    cout << "You have " << currentUser.loyaltyPoints << " loyalty points." << endl;
+    
+    int pointsToRedeem;
+    cout << "Enter the number of points to redeem (100 points = P10 discount): ";
+    cin >> pointsToRedeem;
+    
+    if (cin.fail() || pointsToRedeem < 0) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a positive number.\n";
+        pause();
+        return;
+    }
+    
+    if (pointsToRedeem > currentUser.loyaltyPoints) {
+        cout << "You don't have enough points to redeem." << endl;
+    } else {
+        int discount = pointsToRedeem / 10;
+        currentUser.loyaltyPoints -= pointsToRedeem;
+        journalLoyaltyPoints(currentUser);
+        cout << "You've redeemed " << pointsToRedeem << " points for a P" << discount << " discount on your next purchase." << endl;
+        cout << "Remaining loyalty points: " << currentUser.loyaltyPoints << endl;
+    }
+    pause();
+}
+
+void saveDataToFile() {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_SAVE_DATA);
+    if (compactJournal()) {
+        cout << "Data saved successfully!" << endl;
+    } else {
+        cout << "Unable to save data to file." << endl;
+    }
+}
+
+void loadDataFromFile() {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_LOAD_DATA);
+    uint64_t journalSequence = 0;
+    if (loadSnapshot(SNAPSHOT_FILE, journalSequence)) {
+        cout << "Data loaded successfully!" << endl;
+    } else if (importDataFromText(TEXT_DATA_FILE)) {
+        // Older installs only have the text file; the next save converts it
+        cout << "Data imported from " << TEXT_DATA_FILE << " successfully!" << endl;
+    } else {
+        cout << "No saved data found. Starting with empty inventory and user base." << endl;
+    }
+
+    size_t recovered = replayJournal(journalSequence);
+    if (recovered > 0) {
+        cout << "Recovered " << recovered << " change(s) from " << JOURNAL_FILE << "." << endl;
+    }
+    rebuildRepairQueue();
+    rebuildRepairStatusIndex();
+    rebuildTechnicianRegistry();
+    if (!openJournal()) {
+        cout << "Warning: unable to open " << JOURNAL_FILE << "; changes are only saved on exit." << endl;
+    }
+}
+
+bool mapFile(const char* path, MappedFile& file) {
+    unmapFile(file);
+#ifdef _WIN32
+    ifstream inFile(path, ios::binary | ios::ate);
+    if (!inFile.is_open()) {
+        return false;
+    }
+    file.buffer.resize(static_cast<size_t>(inFile.tellg()));
+    inFile.seekg(0);
+    inFile.read(file.buffer.data(), file.buffer.size());
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    return true;
+#else
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fileno(fp), &info) != 0 || info.st_size == 0) {
+        fclose(fp);
+        return false;
+    }
+    void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    fclose(fp); // the mapping stays valid after the descriptor is closed
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    file.data = static_cast<const char*>(addr);
+    file.size = info.st_size;
+    file.mapped = true;
+    return true;
+#endif
+}
+
+void unmapFile(MappedFile& file) {
+#ifndef _WIN32
+    if (file.mapped) {
+        munmap(const_cast<char*>(file.data), file.size);
+    }
+#endif
+    file.data = nullptr;
+    file.size = 0;
+    file.mapped = false;
+    file.buffer.clear();
+}
+
+// Deduplicating builder for the snapshot string pool
+struct StringPoolWriter {
+    string bytes;
+    unordered_map<string, uint32_t> offsets;
+
+    PooledString add(const string& value) {
+        auto it = offsets.find(value);
+        if (it != offsets.end()) {
+            return {it->second, static_cast<uint32_t>(value.size())};
+        }
+        uint32_t offset = static_cast<uint32_t>(bytes.size());
+        bytes += value;
+        offsets.emplace(value, offset);
+        return {offset, static_cast<uint32_t>(value.size())};
+    }
+};
+
+template <typename Record>
+void writeSection(ofstream& outFile, SnapshotSection& section, const vector<Record>& records) {
+    uint64_t offset = outFile.tellp();
+    uint64_t padding = (8 - offset % 8) % 8;
+    outFile.write("\0\0\0\0\0\0\0", padding);
+    section.offset = offset + padding;
+    section.count = records.size();
+    outFile.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+}
+
+bool saveSnapshot(const char* path) {
+    StringPoolWriter pool;
+
+    vector<ItemRecord> itemRecords;
+    itemRecords.reserve(inventory.size());
+    for (const auto& item : inventory) {
+        itemRecords.push_back({pool.add(item.name), pool.add(item.condition), pool.add(item.category),
+                               item.price, item.stock, item.sku, 0});
+    }
+
+    vector<PooledString> itemNameRefs;
+    itemNameRefs.reserve(transactions.itemNames.names.size());
+    for (const auto& name : transactions.itemNames.names) {
+        itemNameRefs.push_back(pool.add(name));
+    }
+    vector<TransactionRecord> transactionRecords;
+    transactionRecords.reserve(transactions.size());
+    for (size_t i = 0; i < transactions.size(); i++) {
+        transactionRecords.push_back({itemNameRefs[transactions.itemIds[i]], transactions.timestamps[i],
+                                      transactions.prices[i], 0});
+    }
+
+    const SalesAggregates& stats = transactions.stats;
+    vector<ItemStatsRecord> itemStatsRecords;
+    for (uint32_t id = 0; id < stats.itemSales.size(); id++) {
+        if (stats.itemSales[id] > 0) {
+            itemStatsRecords.push_back({pool.add(transactions.itemNames.names[id]), stats.itemSales[id], 0,
+                                        stats.itemRevenue[id]});
+        }
+    }
+    vector<BucketStatsRecord> dayStatsRecords;
+    dayStatsRecords.reserve(stats.byDay.size());
+    for (const auto& day : stats.byDay) {
+        dayStatsRecords.push_back({day.first, day.second.revenue, day.second.sales, 0});
+    }
+    vector<BucketStatsRecord> hourStatsRecords;
+    for (int hour = 0; hour < 24; hour++) {
+        hourStatsRecords.push_back({hour, stats.byHour[hour].revenue, stats.byHour[hour].sales, 0});
+    }
+
+    vector<RepairRecord> repairRecords;
+    repairRecords.reserve(repairRequests.size());
+    for (const auto& req : repairRequests) {
+        repairRecords.push_back({pool.add(req.itemName), pool.add(req.issue), pool.add(REPAIR_STATUS_NAMES[req.status]),
+                                 pool.add(req.assignedTechnician), static_cast<int64_t>(req.submissionTime),
+                                 req.complexity, req.serviceTier});
+    }
+
+    vector<UserRecord> userRecords;
+    userRecords.reserve(users.size());
+    for (const auto& user : users) {
+        userRecords.push_back({pool.add(user.first), pool.add(user.second.password), user.second.isStudent,
+                               user.second.loyaltyPoints, user.second.repairExpertise, 0});
+    }
+
+    // Write next to the old snapshot and rename over it, so a crash never
+    // leaves a half-written file behind.
+    string tempPath = string(path) + ".tmp";
+    ofstream outFile(tempPath, ios::binary | ios::trunc);
+    if (!outFile.is_open()) {
+        return false;
+    }
+
+    SnapshotHeader header = {};
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.journalSequence = journal.nextSequence - 1;
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(outFile, header.items, itemRecords);
+    writeSection(outFile, header.transactions, transactionRecords);
+    writeSection(outFile, header.repairs, repairRecords);
+    writeSection(outFile, header.users, userRecords);
+    writeSection(outFile, header.itemStats, itemStatsRecords);
+    writeSection(outFile, header.dayStats, dayStatsRecords);
+    writeSection(outFile, header.hourStats, hourStatsRecords);
+    header.strings.offset = outFile.tellp();
+    header.strings.count = pool.bytes.size();
+    outFile.write(pool.bytes.data(), pool.bytes.size());
+
+    outFile.seekp(0);
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outFile.close();
+    if (!outFile) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    remove(path);
+#endif
+    return rename(tempPath.c_str(), path) == 0;
+}
+
+bool snapshotSectionFits(const SnapshotSection& section, size_t recordSize, size_t fileSize) {
+    return section.offset <= fileSize && section.count <= (fileSize - section.offset) / recordSize;
+}
+
+string readPooledString(const MappedFile& file, const SnapshotHeader& header, PooledString ref) {
+    if (ref.offset > header.strings.count || ref.length > header.strings.count - ref.offset) {
+        return string();
+    }
+    return string(file.data + header.strings.offset + ref.offset, ref.length);
+}
+
+template <typename Record>
+Record readRecord(const MappedFile& file, const SnapshotSection& section, size_t index) {
+    Record record;
+    memcpy(&record, file.data + section.offset + index * sizeof(Record), sizeof(Record));
+    return record;
+}
+
+bool loadSnapshot(const char* path, uint64_t& journalSequence) {
+    MappedFile file;
+    if (!mapFile(path, file)) {
+        return false;
+    }
+
+    SnapshotHeader header = {};
+    if (file.size < SNAPSHOT_V1_HEADER_SIZE) {
+        unmapFile(file);
+        return false;
+    }
+    memcpy(&header, file.data, min(file.size, sizeof(header)));
+    if (header.version == 1) {
+        header.journalSequence = 0;
+    }
+    if (header.version < 4) {
+        header.itemStats = header.dayStats = header.hourStats = SnapshotSection();
+    }
+    // Before version 3 item records had no SKU; one is assigned on load
+    size_t itemRecordSize = header.version >= 3 ? sizeof(ItemRecord) : ITEM_RECORD_V2_SIZE;
+    if (header.magic != SNAPSHOT_MAGIC || header.version < 1 || header.version > SNAPSHOT_VERSION ||
+        (header.version >= 2 && file.size < SNAPSHOT_V3_HEADER_SIZE) ||
+        (header.version >= 4 && file.size < sizeof(header)) ||
+        !snapshotSectionFits(header.items, itemRecordSize, file.size) ||
+        !snapshotSectionFits(header.transactions, sizeof(TransactionRecord), file.size) ||
+        !snapshotSectionFits(header.repairs, sizeof(RepairRecord), file.size) ||
+        !snapshotSectionFits(header.users, sizeof(UserRecord), file.size) ||
+        !snapshotSectionFits(header.strings, 1, file.size) ||
+        !snapshotSectionFits(header.itemStats, sizeof(ItemStatsRecord), file.size) ||
+        !snapshotSectionFits(header.dayStats, sizeof(BucketStatsRecord), file.size) ||
+        !snapshotSectionFits(header.hourStats, sizeof(BucketStatsRecord), file.size)) {
+        cout << "Snapshot " << path << " is corrupt or from an unsupported version." << endl;
+        unmapFile(file);
+        return false;
+    }
+
+    inventory.clear();
+    inventory.reserve(header.items.count);
+    for (size_t i = 0; i < header.items.count; i++) {
+        ItemRecord rec = {};
+        memcpy(&rec, file.data + header.items.offset + i * itemRecordSize, itemRecordSize);
+        inventory.push_back({readPooledString(file, header, rec.name), readPooledString(file, header, rec.condition),
+                             rec.price, rec.stock, readPooledString(file, header, rec.category), {}, rec.sku});
+    }
+    rebuildInventoryIndex();
+
+    repairRequests.clear();
+    repairRequests.reserve(header.repairs.count);
+    for (size_t i = 0; i < header.repairs.count; i++) {
+        RepairRecord rec = readRecord<RepairRecord>(file, header.repairs, i);
+        repairRequests.push_back({readPooledString(file, header, rec.itemName), readPooledString(file, header, rec.issue),
+                                  loadRepairStatus(readPooledString(file, header, rec.status)),
+                                  static_cast<time_t>(rec.submissionTime),
+                                  rec.complexity, readPooledString(file, header, rec.assignedTechnician),
+                                  validServiceTier(rec.serviceTier)});
+    }
+
+    users.clear();
+    for (size_t i = 0; i < header.users.count; i++) {
+        UserRecord rec = readRecord<UserRecord>(file, header.users, i);
+        string username = readPooledString(file, header, rec.username);
+        users[username] = {username, readPooledString(file, header, rec.password), rec.isStudent != 0,
+                           rec.loyaltyPoints, {}, rec.repairExpertise};
+    }
+
+    journalSequence = header.journalSequence;
+
+    // Restore the running sales aggregates instead of recomputing them
+    transactions.clear();
+    SalesAggregates& stats = transactions.stats;
+    for (size_t i = 0; i < header.itemStats.count; i++) {
+        ItemStatsRecord rec = readRecord<ItemStatsRecord>(file, header.itemStats, i);
+        uint32_t id = transactions.itemNames.intern(readPooledString(file, header, rec.itemName));
+        if (id >= stats.itemSales.size()) {
+            stats.itemSales.resize(id + 1, 0);
+            stats.itemRevenue.resize(id + 1, 0);
+        }
+        stats.itemSales[id] += rec.sales;
+        stats.itemRevenue[id] += rec.revenue;
+        stats.totalRevenue += rec.revenue;
+    }
+    stats.rebuildTopSellers();
+    for (size_t i = 0; i < header.dayStats.count; i++) {
+        BucketStatsRecord rec = readRecord<BucketStatsRecord>(file, header.dayStats, i);
+        stats.byDay[rec.key] = {rec.sales, rec.revenue};
+    }
+    for (size_t i = 0; i < header.hourStats.count; i++) {
+        BucketStatsRecord rec = readRecord<BucketStatsRecord>(file, header.hourStats, i);
+        if (rec.key >= 0 && rec.key < 24) {
+            stats.byHour[rec.key] = {rec.sales, rec.revenue};
+        }
+    }
+
+    // Leave the transaction section mapped; it is decoded on first use
+    unmapFile(snapshotMapping);
+    snapshotMapping = move(file);
+    transactions.pendingRows = header.transactions.count;
+    transactionHistoryPending = header.transactions.count > 0;
+    if (!transactionHistoryPending) {
+        unmapFile(snapshotMapping);
+    } else if (header.version < 4) {
+        // Older snapshots carry no aggregates; derive them once from the history
+        ensureTransactionHistoryLoaded();
+        transactions.rebuildStats();
+    }
+    return true;
+}
+
+void ensureTransactionHistoryLoaded() {
+    if (!transactionHistoryPending) {
+        return;
+    }
+    const MappedFile& file = snapshotMapping;
+    SnapshotHeader header = {};
+    memcpy(&header, file.data, min(file.size, sizeof(header)));
+
+    // Names are decoded once per distinct pool entry, not once per row
+    size_t count = header.transactions.count;
+    unordered_map<uint32_t, uint32_t> idByPoolOffset;
+    vector<uint32_t> itemIds(count);
+    vector<int32_t> prices(count);
+    vector<int64_t> timestamps(count);
+    for (size_t i = 0; i < count; i++) {
+        TransactionRecord rec = readRecord<TransactionRecord>(file, header.transactions, i);
+        auto it = idByPoolOffset.find(rec.itemName.offset);
+        if (it == idByPoolOffset.end()) {
+            uint32_t id = transactions.itemNames.intern(readPooledString(file, header, rec.itemName));
+            it = idByPoolOffset.emplace(rec.itemName.offset, id).first;
+        }
+        itemIds[i] = it->second;
+        prices[i] = rec.price;
+        timestamps[i] = rec.timestamp;
+    }
+
+    // Sales recorded since boot were appended after the snapshot's history
+    transactions.itemIds.insert(transactions.itemIds.begin(), itemIds.begin(), itemIds.end());
+    transactions.prices.insert(transactions.prices.begin(), prices.begin(), prices.end());
+    transactions.timestamps.insert(transactions.timestamps.begin(), timestamps.begin(), timestamps.end());
+    transactions.pendingRows = 0;
+
+    transactionHistoryPending = false;
+    unmapFile(snapshotMapping);
+}
+
+bool exportDataToText(const string& path) {
+    ensureTransactionHistoryLoaded();
+    ofstream outFile(path);
+    if (!outFile.is_open()) {
+        return false;
+    }
+    // Save inventory
+    outFile << inventory.size() << endl;
+    for (const auto& item : inventory) {
+        outFile << item.name << "|" << item.condition << "|" << item.price << "|" << item.stock << "|" << item.category << endl;
+    }
+
+    // Save transactions
+    outFile << transactions.size() << endl;
+    for (size_t i = 0; i < transactions.size(); i++) {
+        outFile << transactions.itemName(i) << "|" << transactions.prices[i] << "|" << transactions.timestamps[i] << endl;
+    }
+
+    // Save repair requests
+    outFile << repairRequests.size() << endl;
+    for (const auto& req : repairRequests) {
+        outFile << req.itemName << "|" << req.issue << "|" << req.status << "|" << req.submissionTime << endl;
+    }
+
+    // Save user accounts
+    outFile << users.size() << endl;
+    for (const auto& user : users) {
+        outFile << user.first << "|" << user.second.password << "|" << user.second.isStudent << "|" << user.second.loyaltyPoints << endl;
+    }
+
+    outFile.close();
+    return true;
+}
+
+bool importDataFromText(const string& path) {
+    ifstream inFile(path);
+    if (!inFile.is_open()) {
+        return false;
+    }
+    string line;
+    int count;
+
+    // Load inventory
+    inFile >> count;
+    inFile.ignore();
+    inventory.clear();
+    for (int i = 0; i < count; i++) {
+        getline(inFile, line);
+        istringstream iss(line);
+        string name, condition, category;
+        int price, stock;
+        getline(iss, name, '|');
+        getline(iss, condition, '|');
+        iss >> price;
+        iss.ignore();
+        iss >> stock;
+        iss.ignore();
+        getline(iss, category);
+        inventory.push_back({name, condition, price, stock, category});
+    }
+    rebuildInventoryIndex();
+
+    // Load transactions
+    inFile >> count;
+    inFile.ignore();
+    transactions.clear();
+    transactionHistoryPending = false;
+    unmapFile(snapshotMapping);
+    for (int i = 0; i < count; i++) {
+        getline(inFile, line);
+        istringstream iss(line);
+        string itemName;
+        int price;
+        time_t timestamp;
+        getline(iss, itemName, '|');
+        iss >> price;
+        iss.ignore();
+        iss >> timestamp;
+        transactions.append({itemName, price, timestamp});
+    }
+
+    // Load repair requests
+    inFile >> count;
+    inFile.ignore();
+    repairRequests.clear();
+    for (int i = 0; i < count; i++) {
+        getline(inFile, line);
+        istringstream iss(line);
+        string itemName, issue, status;
+        time_t submissionTime;
+        getline(iss, itemName, '|');
+        getline(iss, issue, '|');
+        getline(iss, status, '|');
+        iss >> submissionTime;
+        repairRequests.push_back({itemName, issue, loadRepairStatus(status), submissionTime});
+    }
+
+    // Load user accounts
+    inFile >> count;
+    inFile.ignore();
+    users.clear();
+    for (int i = 0; i < count; i++) {
+        getline(inFile, line);
+        istringstream iss(line);
+        string username, password;
+        bool isStudent;
+        int loyaltyPoints;
+        getline(iss, username, '|');
+        getline(iss, password, '|');
+        iss >> isStudent;
+        iss.ignore();
+        iss >> loyaltyPoints;
+        users[username] = {username, password, isStudent, loyaltyPoints};
+    }
+
+    inFile.close();
+    return true;
+}
+
+// Status from saved or typed text, ignoring case. Files written before the
+// status list was fixed can hold other words (or just "in" from a one-word
+// prompt); those are read by their closest meaning, else as pending.
+RepairStatus loadRepairStatus(const string& text) {
+    string normalized = normalizeText(text);
+    for (int status = 0; status < REPAIR_STATUS_COUNT; status++) {
+        if (normalized == normalizeText(REPAIR_STATUS_NAMES[status])) {
+            return static_cast<RepairStatus>(status);
+        }
+    }
+    if (normalized.compare(0, 2, "in") == 0) {
+        return REPAIR_IN_PROGRESS;
+    }
+    if (normalized.compare(0, 8, "complete") == 0 || normalized == "done") {
+        return REPAIR_COMPLETED;
+    }
+    return REPAIR_PENDING;
+}
+
+// Exact status name, ignoring case and spacing
+bool parseRepairStatus(const string& text, RepairStatus& status) {
+    string normalized = normalizeText(text);
+    for (int candidate = 0; candidate < REPAIR_STATUS_COUNT; candidate++) {
+        if (normalized == normalizeText(REPAIR_STATUS_NAMES[candidate])) {
+            status = static_cast<RepairStatus>(candidate);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parsePrintStatus(const string& text, PrintStatus& status) {
+    string normalized = normalizeText(text);
+    for (int candidate = 0; candidate < PRINT_STATUS_COUNT; candidate++) {
+        if (normalized == normalizeText(PRINT_STATUS_NAMES[candidate])) {
+            status = static_cast<PrintStatus>(candidate);
+            return true;
+        }
+    }
+    return false;
+}
+
+string normalizeText(const string& text) {
+    // Lowercase and collapse runs of whitespace, so "Wireless  Headphones"
+    // and "wireless headphones" compare equal
+    string normalized;
+    normalized.reserve(text.size());
+    bool pendingSpace = false;
+    for (unsigned char c : text) {
+        if (isspace(c)) {
+            pendingSpace = !normalized.empty();
+        } else {
+            if (pendingSpace) {
+                normalized += ' ';
+                pendingSpace = false;
+            }
+            normalized += static_cast<char>(tolower(c));
+        }
+    }
+    return normalized;
+}
+
+ItemCategory categoryOf(const string& category) {
+    string normalized = normalizeText(category);
+    for (int c = 0; c < CATEGORY_OTHER; c++) {
+        if (normalized == normalizeText(CATEGORY_NAMES[c])) {
+            return static_cast<ItemCategory>(c);
+        }
+    }
+    return CATEGORY_OTHER;
+}
+
+void indexInventoryItem(size_t position) {
+    Item& item = inventory[position];
+    if (item.sku <= 0 || inventoryIndex.bySku.find(item.sku) >= 0) {
+        item.sku = nextSku;
+    }
+    nextSku = max(nextSku, item.sku + 1);
+    inventoryIndex.bySku.insert(item.sku, static_cast<int>(position));
+
+    inventoryIndex.normalizedNames.push_back(normalizeText(item.name));
+    inventoryIndex.nextWithSameName.push_back(-1);
+    int first = inventoryIndex.byName.insert(inventoryIndex.normalizedNames.back(), static_cast<int>(position));
+    if (first != static_cast<int>(position)) {
+        // Same name, different condition: append to that name's chain
+        int last = first;
+        while (inventoryIndex.nextWithSameName[last] >= 0) {
+            last = inventoryIndex.nextWithSameName[last];
+        }
+        inventoryIndex.nextWithSameName[last] = static_cast<int>(position);
+    }
+
+    inventoryIndex.byCategory[categoryOf(item.category)].push_back(static_cast<int>(position));
+    inventoryIndex.text.add(static_cast<int>(position), item);
+}
+
+void rebuildInventoryIndex() {
+    inventoryIndex.bySku.clear();
+    inventoryIndex.byName.clear();
+    inventoryIndex.nextWithSameName.clear();
+    inventoryIndex.normalizedNames.clear();
+    for (auto& members : inventoryIndex.byCategory) {
+        members.clear();
+    }
+    inventoryIndex.text.clear();
+    nextSku = 1;
+    for (const auto& item : inventory) {
+        nextSku = max(nextSku, item.sku + 1);
+    }
+    for (size_t i = 0; i < inventory.size(); i++) {
+        indexInventoryItem(i);
+    }
+}
+
+size_t addInventoryItem(const Item& item) {
+    unique_lock<shared_mutex> lock(inventoryMutex);
+    inventory.push_back(item);
+    indexInventoryItem(inventory.size() - 1);
+    return inventory.size() - 1;
+}
+
+Item* findItemBySku(int sku) {
+    int position = inventoryIndex.bySku.find(sku);
+    return position >= 0 ? &inventory[position] : nullptr;
+}
+
+Item* findItemByName(const string& name) {
+    int position = inventoryIndex.byName.find(normalizeText(name));
+    return position >= 0 ? &inventory[position] : nullptr;
+}
+
+uint32_t journalChecksum(const char* data, size_t size) {
+    // FNV-1a; only needs to catch torn or garbled tail records
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void putU32(string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putI64(string& out, int64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(string& out, const string& value) {
+    putU32(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+// Bounds-checked cursor over one journal record payload
+struct JournalReader {
+    const char* pos;
+    const char* end;
+    bool ok = true;
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(value))) {
+            ok = false;
+            return 0;
+        }
+        memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+
+    int64_t i64() {
+        int64_t value = 0;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(value))) {
+            ok = false;
+            return 0;
+        }
+        memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+
+    bool atEnd() const { return pos >= end; }
+
+    string str() {
+        uint32_t length = u32();
+        if (!ok || static_cast<size_t>(end - pos) < length) {
+            ok = false;
+            return string();
+        }
+        string value(pos, length);
+        pos += length;
+        return value;
+    }
+};
+
+// The current journal, if any, stays open until the new one is
+bool openJournal() {
+#ifdef _WIN32
+    int fd = _open(JOURNAL_FILE, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = open(JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+    if (fd < 0) {
+        return false;
+    }
+    closeJournal();
+    lock_guard<mutex> lock(journal.lock);
+    journal.fd = fd;
+    journal.reportedClosed = false;
+    journal.lastSync = chrono::steady_clock::now();
+    return true;
+}
+
+void closeJournal() {
+    if (journal.fd < 0) {
+        return;
+    }
+    syncJournal();
+#ifdef _WIN32
+    _close(journal.fd);
+#else
+    close(journal.fd);
+#endif
+    journal.fd = -1;
+    journal.reportedClosed = true; // closed on purpose
+}
+
+void syncJournal() {
+    TRACE_FUNCTION();
+    lock_guard<mutex> lock(journal.lock);
+    syncJournalLocked();
+}
+
+void syncJournalLocked() {
+    if (journal.fd < 0 || journal.unsyncedRecords == 0) {
+        return;
+    }
+#ifdef _WIN32
+    _commit(journal.fd);
+#else
+    fsync(journal.fd);
+#endif
+    journal.unsyncedRecords = 0;
+    journal.lastSync = chrono::steady_clock::now();
+}
+
+void appendJournalRecord(JournalRecordType type, const string& payload) {
+    lock_guard<mutex> lock(journal.lock);
+    if (journal.fd < 0) {
+        if (!journal.reportedClosed) {
+            journal.reportedClosed = true;
+            cout << "Warning: " << JOURNAL_FILE << " is not open; changes are only saved on exit." << endl;
+        }
+        return;
+    }
+    // Layout: length | checksum | sequence | type | payload
+    string body;
+    body.reserve(sizeof(uint64_t) + 1 + payload.size());
+    putI64(body, static_cast<int64_t>(journal.nextSequence));
+    body += static_cast<char>(type);
+    body += payload;
+
+    string record;
+    record.reserve(2 * sizeof(uint32_t) + body.size());
+    putU32(record, static_cast<uint32_t>(body.size()));
+    putU32(record, journalChecksum(body.data(), body.size()));
+    record += body;
+
+    // One write per record hands it to the OS, which is enough to survive a
+    // crash of this process; fsync is batched across records (group commit).
+#ifdef _WIN32
+    bool written = _write(journal.fd, record.data(), static_cast<unsigned>(record.size())) ==
+                   static_cast<int>(record.size());
+#else
+    bool written = write(journal.fd, record.data(), record.size()) == static_cast<ssize_t>(record.size());
+#endif
+    if (!written) {
+        // Cut a partial record off again, or replay would stop at it and drop
+        // every record after it. If that fails too, stop journaling so the
+        // data is saved on exit instead.
+#ifdef _WIN32
+        bool restored = _chsize(journal.fd, static_cast<long>(journal.bytes)) == 0;
+#else
+        bool restored = ftruncate(journal.fd, static_cast<off_t>(journal.bytes)) == 0;
+#endif
+        if (restored) {
+            cout << "Warning: failed to write to " << JOURNAL_FILE << "; this change is only saved on exit." << endl;
+        } else {
+#ifdef _WIN32
+            _close(journal.fd);
+#else
+            close(journal.fd);
+#endif
+            journal.fd = -1;
+            journal.reportedClosed = true;
+            cout << "Warning: failed to write to " << JOURNAL_FILE << "; changes are only saved on exit." << endl;
+        }
+        return;
+    }
+    journal.nextSequence++;
+    journal.bytes += record.size();
+    journal.unsyncedRecords++;
+
+    auto sinceSync = chrono::steady_clock::now() - journal.lastSync;
+    if (journal.unsyncedRecords >= JOURNAL_SYNC_RECORDS ||
+        sinceSync >= chrono::milliseconds(JOURNAL_SYNC_INTERVAL_MS)) {
+        syncJournalLocked();
+    }
+}
+
+// Sales and stock changes are journaled as deltas: with several counters
+// committing at once, an absolute stock level read at commit time could
+// still include another counter's unsold reservation.
+void journalSale(const Item& item, const Transaction& trans, const User& user) {
+    string payload;
+    putU32(payload, static_cast<uint32_t>(item.sku));
+    putString(payload, trans.itemName);
+    putU32(payload, static_cast<uint32_t>(trans.price));
+    putI64(payload, static_cast<int64_t>(trans.timestamp));
+    putString(payload, user.username);
+    putU32(payload, static_cast<uint32_t>(user.loyaltyPoints));
+    appendJournalRecord(JOURNAL_SALE, payload);
+}
+
+void journalStockChange(const Item& item, int delta) {
+    string payload;
+    putU32(payload, static_cast<uint32_t>(item.sku));
+    putU32(payload, static_cast<uint32_t>(delta));
+    appendJournalRecord(JOURNAL_STOCK, payload);
+}
+
+void journalNewItem(const Item& item) {
+    string payload;
+    putString(payload, item.name);
+    putString(payload, item.condition);
+    putU32(payload, static_cast<uint32_t>(item.price));
+    putU32(payload, static_cast<uint32_t>(item.stock));
+    putString(payload, item.category);
+    putU32(payload, static_cast<uint32_t>(item.sku));
+    appendJournalRecord(JOURNAL_NEW_ITEM, payload);
+}
+
+void journalRepairAdded(const RepairRequest& req) {
+    string payload;
+    putString(payload, req.itemName);
+    putString(payload, req.issue);
+    putString(payload, REPAIR_STATUS_NAMES[req.status]);
+    putI64(payload, static_cast<int64_t>(req.submissionTime));
+    putU32(payload, static_cast<uint32_t>(req.complexity));
+    putString(payload, req.assignedTechnician);
+    putU32(payload, static_cast<uint32_t>(req.serviceTier));
+    appendJournalRecord(JOURNAL_REPAIR_ADDED, payload);
+}
+
+void journalRepairStatus(size_t requestIndex) {
+    string payload;
+    putU32(payload, static_cast<uint32_t>(requestIndex));
+    putString(payload, REPAIR_STATUS_NAMES[repairRequests[requestIndex].status]);
+    appendJournalRecord(JOURNAL_REPAIR_STATUS, payload);
+}
+
+void journalRepairAssigned(size_t requestIndex) {
+    string payload;
+    putU32(payload, static_cast<uint32_t>(requestIndex));
+    putString(payload, repairRequests[requestIndex].assignedTechnician);
+    putString(payload, REPAIR_STATUS_NAMES[repairRequests[requestIndex].status]);
+    appendJournalRecord(JOURNAL_REPAIR_ASSIGNED, payload);
+}
+
+void journalRepairPriority(size_t requestIndex) {
+    string payload;
+    putU32(payload, static_cast<uint32_t>(requestIndex));
+    putU32(payload, static_cast<uint32_t>(repairRequests[requestIndex].complexity));
+    putU32(payload, static_cast<uint32_t>(repairRequests[requestIndex].serviceTier));
+    appendJournalRecord(JOURNAL_REPAIR_PRIORITY, payload);
+}
+
+void journalUserRegistered(const User& user) {
+    string payload;
+    putString(payload, user.username);
+    putString(payload, user.password);
+    putU32(payload, user.isStudent ? 1 : 0);
+    putU32(payload, static_cast<uint32_t>(user.loyaltyPoints));
+    putU32(payload, static_cast<uint32_t>(user.repairExpertise));
+    appendJournalRecord(JOURNAL_USER_REGISTERED, payload);
+}
+
+void journalLoyaltyPoints(const User& user) {
+    string payload;
+    putString(payload, user.username);
+    putU32(payload, static_cast<uint32_t>(user.loyaltyPoints));
+    appendJournalRecord(JOURNAL_LOYALTY_POINTS, payload);
+}
+
+void journalTechnicianExpertise(const User& user) {
+    string payload;
+    putString(payload, user.username);
+    putU32(payload, static_cast<uint32_t>(user.repairExpertise));
+    appendJournalRecord(JOURNAL_TECHNICIAN_EXPERTISE, payload);
+}
+
+bool applyJournalRecord(JournalRecordType type, JournalReader& in) {
+    switch (type) {
+        case JOURNAL_SALE: {
+            int sku = static_cast<int>(in.u32());
+            string itemName = in.str();
+            int price = static_cast<int>(in.u32());
+            time_t timestamp = static_cast<time_t>(in.i64());
+            string username = in.str();
+            int loyaltyPoints = static_cast<int>(in.u32());
+            Item* item = findItemBySku(sku);
+            if (!in.ok || !item) {
+                return false;
+            }
+            item->stock--;
+            transactions.append({itemName, price, timestamp});
+            auto it = users.find(username);
+            if (it != users.end()) {
+                it->second.loyaltyPoints = loyaltyPoints;
+            }
+            return true;
+        }
+        case JOURNAL_STOCK: {
+            int sku = static_cast<int>(in.u32());
+            int delta = static_cast<int>(in.u32());
+            Item* item = findItemBySku(sku);
+            if (!in.ok || !item) {
+                return false;
+            }
+            item->stock += delta;
+            return true;
+        }
+        case JOURNAL_NEW_ITEM: {
+            Item item;
+            item.name = in.str();
+            item.condition = in.str();
+            item.price = static_cast<int>(in.u32());
+            item.stock = static_cast<int>(in.u32());
+            item.category = in.str();
+            item.sku = static_cast<int>(in.u32());
+            if (!in.ok) {
+                return false;
+            }
+            addInventoryItem(item);
+            return true;
+        }
+        case JOURNAL_REPAIR_ADDED: {
+            RepairRequest req;
+            req.itemName = in.str();
+            req.issue = in.str();
+            req.status = loadRepairStatus(in.str());
+            req.submissionTime = static_cast<time_t>(in.i64());
+            req.complexity = static_cast<int>(in.u32());
+            req.assignedTechnician = in.str();
+            // Records from before service tiers end here
+            req.serviceTier = in.atEnd() ? TIER_STANDARD : validServiceTier(static_cast<int>(in.u32()));
+            if (!in.ok) {
+                return false;
+            }
+            repairRequests.push_back(req);
+            return true;
+        }
+        case JOURNAL_REPAIR_STATUS: {
+            uint32_t requestIndex = in.u32();
+            string status = in.str();
+            if (!in.ok || requestIndex >= repairRequests.size()) {
+                return false;
+            }
+            repairRequests[requestIndex].status = loadRepairStatus(status);
+            return true;
+        }
+        case JOURNAL_REPAIR_ASSIGNED: {
+            uint32_t requestIndex = in.u32();
+            string technician = in.str();
+            string status = in.str();
+            if (!in.ok || requestIndex >= repairRequests.size()) {
+                return false;
+            }
+            repairRequests[requestIndex].assignedTechnician = technician;
+            repairRequests[requestIndex].status = loadRepairStatus(status);
+            return true;
+        }
+        case JOURNAL_REPAIR_PRIORITY: {
+            uint32_t requestIndex = in.u32();
+            int complexity = static_cast<int>(in.u32());
+            int serviceTier = static_cast<int>(in.u32());
+            if (!in.ok || requestIndex >= repairRequests.size()) {
+                return false;
+            }
+            repairRequests[requestIndex].complexity = complexity;
+            repairRequests[requestIndex].serviceTier = validServiceTier(serviceTier);
+            return true;
+        }
+        case JOURNAL_USER_REGISTERED: {
+            User user;
+            user.username = in.str();
+            user.password = in.str();
+            user.isStudent = in.u32() != 0;
+            user.loyaltyPoints = static_cast<int>(in.u32());
+            user.repairExpertise = static_cast<int>(in.u32());
+            if (!in.ok) {
+                return false;
+            }
+            users[user.username] = user;
+            return true;
+        }
+        case JOURNAL_LOYALTY_POINTS: {
+            string username = in.str();
+            int loyaltyPoints = static_cast<int>(in.u32());
+            if (!in.ok) {
+                return false;
+            }
+            auto it = users.find(username);
+            if (it != users.end()) {
+                it->second.loyaltyPoints = loyaltyPoints;
+            }
+            return true;
+        }
+        case JOURNAL_TECHNICIAN_EXPERTISE: {
+            string username = in.str();
+            int expertise = static_cast<int>(in.u32());
+            if (!in.ok) {
+                return false;
+            }
+            auto it = users.find(username);
+            if (it != users.end()) {
+                it->second.repairExpertise = expertise;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t replayJournal(uint64_t snapshotSequence) {
+    journal.nextSequence = snapshotSequence + 1;
+    journal.bytes = 0;
+
+    MappedFile file;
+    if (!mapFile(JOURNAL_FILE, file)) {
+        return 0;
+    }
+
+    size_t applied = 0;
+    size_t skipped = 0;
+    size_t offset = 0;
+    const size_t headerSize = 2 * sizeof(uint32_t);
+    while (file.size - offset >= headerSize) {
+        uint32_t length, checksum;
+        memcpy(&length, file.data + offset, sizeof(length));
+        memcpy(&checksum, file.data + offset + sizeof(length), sizeof(checksum));
+        const char* body = file.data + offset + headerSize;
+        if (length < sizeof(uint64_t) + 1 || length > file.size - offset - headerSize ||
+            journalChecksum(body, length) != checksum) {
+            break; // torn write from a crash; everything after it is discarded
+        }
+
+        uint64_t sequence;
+        memcpy(&sequence, body, sizeof(sequence));
+        JournalRecordType type = static_cast<JournalRecordType>(body[sizeof(sequence)]);
+        JournalReader in = {body + sizeof(sequence) + 1, body + length};
+        // Records already folded into the snapshot are skipped, which covers
+        // a crash between writing the snapshot and truncating the journal.
+        // A well-formed record that no longer applies (a SKU missing from the
+        // snapshot, an unknown record type) is passed over, not treated as
+        // damage, so the records after it survive.
+        if (sequence > snapshotSequence) {
+            if (applyJournalRecord(type, in)) {
+                applied++;
+            } else {
+                skipped++;
+            }
+        }
+        journal.nextSequence = max(journal.nextSequence, sequence + 1);
+        offset += headerSize + length;
+    }
+    bool truncated = offset < file.size;
+    unmapFile(file);
+
+    if (skipped > 0) {
+        cout << "Skipped " << skipped << " journal record(s) that no longer apply to the loaded data." << endl;
+    }
+    if (truncated) {
+        cout << "Discarding a damaged record at the end of " << JOURNAL_FILE << "." << endl;
+#ifdef _WIN32
+        int fd = _open(JOURNAL_FILE, _O_WRONLY | _O_BINARY);
+        if (fd >= 0) {
+            _chsize(fd, static_cast<long>(offset));
+            _close(fd);
+        }
+#else
+        if (truncate(JOURNAL_FILE, offset) != 0) {
+            cout << "Warning: unable to truncate " << JOURNAL_FILE << "." << endl;
+        }
+#endif
+    }
+    journal.bytes = offset;
+    return applied;
+}
+
+bool compactJournal() {
+    TRACE_FUNCTION();
+    // Fold the journal into a fresh snapshot; the snapshot records the last
+    // sequence it contains, so it is safe to crash before the truncation.
+    // Holding both locks keeps checkouts out while the state is written.
+    unique_lock<shared_mutex> inventoryLock(inventoryMutex);
+    lock_guard<mutex> salesLock(salesMutex);
+    ensureTransactionHistoryLoaded();
+    syncJournal();
+    if (!saveSnapshot(SNAPSHOT_FILE)) {
+        return false;
+    }
+    // The journal is emptied in place, so appends keep going to an open
+    // file even if it could not be reopened. A journal that cannot be
+    // emptied only costs replay time: its records are older than the
+    // snapshot and are skipped on load.
+    {
+        lock_guard<mutex> lock(journal.lock);
+        if (journal.fd >= 0) {
+#ifdef _WIN32
+            bool emptied = _chsize(journal.fd, 0) == 0;
+#else
+            bool emptied = ftruncate(journal.fd, 0) == 0;
+#endif
+            if (emptied) {
+                journal.bytes = 0;
+            } else {
+                cout << "Warning: unable to truncate " << JOURNAL_FILE << "." << endl;
+            }
+            return true;
+        }
+    }
+    remove(JOURNAL_FILE);
+    journal.bytes = 0;
+    if (!openJournal()) {
+        cout << "Warning: unable to open " << JOURNAL_FILE << "; changes are only saved on exit." << endl;
+    }
+    return true;
+}
+
+void maybeCompactJournal() {
+    if (journal.bytes >= JOURNAL_COMPACT_BYTES) {
+        compactJournal();
+    }
+}
+
+void adminExportData() {
+    TRACE_FUNCTION();
     clearScreen();
-    cout << "\n--- Submit a Repair Request ---" << endl;
-    cout << "Enter the name of the item: ";
-    cin.ignore();
-    getline(cin, request.itemName);
-    cout << "Describe the issue: ";
-    getline(cin, request.issue);
+    cout << "\n--- Admin: Export Data to Text ---" << endl;
+    if (exportDataToText(TEXT_DATA_FILE)) {
+        cout << "Data exported to " << TEXT_DATA_FILE << "." << endl;
+    } else {
+        cout << "Unable to export data to " << TEXT_DATA_FILE << "." << endl;
+    }
+    pause();
+}
+
+bool adminImportData() {
+    TRACE_FUNCTION();
+    bool imported = false;
+    clearScreen();
+    cout << "\n--- Admin: Import Data from Text ---" << endl;
+    cout << "This replaces all current shop data with " << TEXT_DATA_FILE << ". Continue? (1 for Yes, 0 for No): ";
+    int confirm;
+    cin >> confirm;
+    if (confirm == 1) {
+        imported = importDataFromText(TEXT_DATA_FILE);
+        if (imported) {
+            // Earlier journal records describe the replaced data; start clean
+            compactJournal();
+            rebuildRepairQueue();
+            rebuildRepairStatusIndex();
+            rebuildTechnicianRegistry();
+            cout << "Data imported from " << TEXT_DATA_FILE << ". Please log in again." << endl;
+        } else {
+            cout << "Unable to read " << TEXT_DATA_FILE << "." << endl;
+        }
+    }
+    pause();
+    return imported;
+}
+
+mutex& stockLockFor(int sku) {
+    return stockLocks[static_cast<size_t>(sku) % STOCK_LOCK_STRIPES];
+}
+
+int availableStock(const Item& item) {
+    lock_guard<mutex> lock(stockLockFor(item.sku));
+    return item.stock - item.reserved;
+}
+
+// Holds `quantity` units of an item for one checkout; fails rather than
+// oversell when fewer units are available.
+bool reserveStock(int sku, int quantity, CheckoutReservation& reservation) {
+    TRACE_FUNCTION();
+    shared_lock<shared_mutex> inventoryLock(inventoryMutex);
+    Item* item = findItemBySku(sku);
+    if (!item || quantity <= 0) {
+        return false;
+    }
+    lock_guard<mutex> stockLock(stockLockFor(sku));
+    if (item->stock - item->reserved < quantity) {
+        return false;
+    }
+    item->reserved += quantity;
+    reservation = {sku, quantity, true};
+    return true;
+}
+
+void abortReservation(CheckoutReservation& reservation) {
+    TRACE_FUNCTION();
+    if (!reservation.active) {
+        return;
+    }
+    shared_lock<shared_mutex> inventoryLock(inventoryMutex);
+    Item* item = findItemBySku(reservation.sku);
+    if (item) {
+        lock_guard<mutex> stockLock(stockLockFor(reservation.sku));
+        item->reserved -= reservation.quantity;
+    }
+    reservation.active = false;
+}
+
+// Turns a reservation into sales: one transaction per unit, loyalty points
+// for the customer, and a journal record each.
+bool commitReservation(CheckoutReservation& reservation, int unitPrice, User& customer) {
+    TRACE_FUNCTION();
+    if (!reservation.active) {
+        return false;
+    }
+    shared_lock<shared_mutex> inventoryLock(inventoryMutex);
+    Item* item = findItemBySku(reservation.sku);
+    if (!item) {
+        return false;
+    }
+    {
+        lock_guard<mutex> stockLock(stockLockFor(reservation.sku));
+        item->reserved -= reservation.quantity;
+        item->stock -= reservation.quantity;
+    }
+
+    lock_guard<mutex> salesLock(salesMutex);
+    time_t now = time(nullptr);
+    for (int i = 0; i < reservation.quantity; i++) {
+        Transaction sale = {item->name, unitPrice, now};
+        transactions.append(sale);
+        customer.loyaltyPoints += POINTS_PER_PURCHASE;
+        journalSale(*item, sale, customer);
+    }
+    reservation.active = false;
+    return true;
+}
+
+// Shop operations shared by the interactive menus and batch mode. They do no
+// console I/O; callers report the outcome in their own format.
+float checkoutPrice(const Item& item, bool studentDiscount) {
+    float price = item.price;
+    if (studentDiscount) {
+        price -= price * STUDENT_DISCOUNT;
+    }
+    return price;
+}
 
-    request.status = "Pending";
-    request.submissionTime = time(nullptr);
+SaleOutcome sellItem(int sku, int payment, bool studentDiscount, User& customer) {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_SELL_ITEM);
+    SaleOutcome outcome;
+    float price;
+    {
+        shared_lock<shared_mutex> inventoryLock(inventoryMutex);
+        Item* item = findItemBySku(sku);
+        if (!item) {
+            outcome.status = SALE_UNKNOWN_ITEM;
+            return outcome;
+        }
+        price = checkoutPrice(*item, studentDiscount);
+    }
+    outcome.price = static_cast<int>(price);
+    if (payment < price) {
+        outcome.status = SALE_INSUFFICIENT_PAYMENT;
+        return outcome;
+    }
 
-    repairRequests.push_back(request);
-    cout << "Your repair request has been submitted successfully!\n" << endl;
-    pause();
+    CheckoutReservation reservation;
+    if (!reserveStock(sku, 1, reservation) ||
+        !commitReservation(reservation, outcome.price, customer)) {
+        abortReservation(reservation);
+        outcome.status = SALE_OUT_OF_STOCK;
+        return outcome;
+    }
+    outcome.change = static_cast<int>(payment - price);
+    shared_lock<shared_mutex> inventoryLock(inventoryMutex);
+    outcome.receiptId = issueReceipt(*findItemBySku(sku), outcome.price, payment, customer);
+    return outcome;
 }
 
-void viewRepairRequests() {
-    clearScreen();
-    if (repairRequests.empty()) {
-        cout << "\nNo repair requests at the moment.\n" << endl;
-    } else {
-        cout << "\n--- Repair Requests ---" << endl;
-        cout << setw(5) << "No." << setw(20) << "Item" << setw(30) << "Issue" 
-             << setw(15) << "Status" << setw(25) << "Submission Time" << endl;
-        cout << string(95, '-') << endl;
-        
-        for (size_t i = 0; i < repairRequests.size(); i++) {
-            cout << setw(5) << i + 1 
-                 << setw(20) << repairRequests[i].itemName 
-                 << setw(30) << repairRequests[i].issue
-                 << setw(15) << repairRequests[i].status
-                 << setw(25) << ctime(&repairRequests[i].submissionTime);
+bool restockItem(int sku, int quantity) {
+    shared_lock<shared_mutex> inventoryLock(inventoryMutex);
+    Item* item = findItemBySku(sku);
+    if (!item || quantity < 0) {
+        return false;
+    }
+    {
+        lock_guard<mutex> stockLock(stockLockFor(sku));
+        item->stock += quantity;
+    }
+    journalStockChange(*item, quantity);
+    return true;
+}
+
+size_t createItem(const Item& item) {
+    size_t position = addInventoryItem(item);
+    journalNewItem(inventory[position]);
+    return position;
+}
+
+int validServiceTier(int serviceTier) {
+    return serviceTier >= 0 && serviceTier < TIER_COUNT ? serviceTier : TIER_STANDARD;
+}
+
+// Tickets are served earliest due time first. Age counts for everything: a
+// complex job is due later than a simple one submitted at the same time, and
+// warranty and subscription tickets get a head start.
+int64_t repairDueTime(const RepairRequest& req) {
+    return static_cast<int64_t>(req.submissionTime) + req.complexity * REPAIR_SECONDS_PER_COMPLEXITY -
+           TIER_HEAD_START[validServiceTier(req.serviceTier)];
+}
+
+// Waiting for a technician
+bool isRepairOpen(const RepairRequest& req) {
+    return req.assignedTechnician.empty() && req.status == REPAIR_PENDING;
+}
+
+// The queue is derived from the repair requests, so it is rebuilt after
+// loading instead of being saved
+void rebuildRepairQueue() {
+    repairQueue.clear();
+    for (size_t i = 0; i < repairRequests.size(); i++) {
+        if (isRepairOpen(repairRequests[i])) {
+            repairQueue.schedule(i, repairDueTime(repairRequests[i]));
         }
     }
-    pause();
 }
 
-void updateRepairStatus() {
-    clearScreen();
-    if (repairRequests.empty()) {
-        cout << "\nNo repair requests to update.\n" << endl;
-    } else {
-        int choice;
-        string newStatus;
-        
-        cout << "\n--- Update Repair Request Status ---" << endl;
-        viewRepairRequests();
-        
-        cout << "Enter the request number to update (0 to cancel): ";
-        cin >> choice;
-        
-        if (cin.fail()) {
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            cout << "Invalid input. Please enter a number.\n";
-            pause();
-            return;
+// Load is every assigned ticket that is not completed yet
+void rebuildTechnicianRegistry() {
+    technicians.clear();
+    for (const auto& user : users) {
+        if (user.second.repairExpertise > 0) {
+            technicians.setExpertise(user.first, user.second.repairExpertise);
         }
-        
-        if (choice > 0 && choice <= static_cast<int>(repairRequests.size())) {
-            cout << "Enter new status (Pending/In Progress/Completed): ";
-            cin >> newStatus;
-            
-            transform(newStatus.begin(), newStatus.end(), newStatus.begin(), ::tolower);
-            if (newStatus == "pending" || newStatus == "in progress" || newStatus == "completed") {
-                repairRequests[choice - 1].status = newStatus;
-                cout << "Status updated successfully!" << endl;
-            } else {
-                cout << "Invalid status. Please enter Pending, In Progress, or Completed." << endl;
+    }
+    for (const auto& req : repairRequests) {
+        if (!req.assignedTechnician.empty() && req.status != REPAIR_COMPLETED) {
+            technicians.adjustLoad(req.assignedTechnician, 1);
+        }
+    }
+}
+
+bool setTechnicianExpertise(const string& username, int expertise) {
+    auto it = users.find(username);
+    if (it == users.end() || expertise < 0) {
+        return false;
+    }
+    it->second.repairExpertise = expertise;
+    journalTechnicianExpertise(it->second);
+    technicians.setExpertise(username, expertise);
+    return true;
+}
+
+// Hands the most urgent open ticket to the nearest-expertise, least-loaded
+// technician. Returns the ticket's request index, or -1 when the queue is
+// empty or nobody is taking repairs.
+int assignNextRepair() {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_ASSIGN_TECHNICIAN);
+    if (repairQueue.empty()) {
+        return -1;
+    }
+    size_t requestIndex = repairQueue.top();
+    RepairRequest& req = repairRequests[requestIndex];
+    string technician = technicians.pick(req.complexity);
+    if (technician.empty()) {
+        return -1;
+    }
+
+    repairQueue.pop();
+    req.assignedTechnician = technician;
+    repairsByStatus.move(requestIndex, req.status, REPAIR_ASSIGNED);
+    req.status = REPAIR_ASSIGNED;
+    technicians.adjustLoad(technician, 1);
+    journalRepairAssigned(requestIndex);
+    return static_cast<int>(requestIndex);
+}
+
+// Drains the queue in priority order, spreading tickets by load as it goes
+size_t assignQueuedRepairs() {
+    size_t assigned = 0;
+    while (assignNextRepair() >= 0) {
+        assigned++;
+    }
+    return assigned;
+}
+
+// Assigns every queued ticket using several threads, with the same result
+// as assignQueuedRepairs(). A ticket only goes to its nearest expertise
+// bucket, or on an exact tie to one of the two around it, so buckets joined
+// by tied tickets form groups that never affect each other. Each group's
+// tickets are replayed in priority order by one worker under the registry's
+// rules (nearest expertise, then least loaded, then username); groups are
+// dealt to per-worker deques and an idle worker steals from the others. The
+// calling thread then applies the whole batch in one pass once every worker
+// has finished.
+BatchAssignStats assignQueuedRepairsParallel(unsigned threadCount) {
+    TRACE_FUNCTION();
+    BatchAssignStats stats;
+    stats.threads = max(threadCount, 1u);
+    auto start = chrono::steady_clock::now();
+
+    vector<size_t> tickets;
+    tickets.reserve(repairQueue.size());
+    repairQueue.forEachInOrder([&tickets](size_t requestIndex) { tickets.push_back(requestIndex); });
+
+    // Copy of the roster, bucketed by expertise as in the registry. Within a
+    // bucket technicians are numbered in username order, so (load, number)
+    // sorts exactly like the registry's (load, username).
+    vector<string> names;
+    vector<int> expertiseLevels;
+    vector<set<pair<int, int>>> buckets;
+    vector<int> initialLoads;
+    for (const auto& bucket : technicians.byExpertise) {
+        vector<pair<string, int>> roster; // (username, load)
+        for (const auto& entry : bucket.second) {
+            roster.push_back({entry.second, entry.first});
+        }
+        sort(roster.begin(), roster.end());
+        expertiseLevels.push_back(bucket.first);
+        buckets.emplace_back();
+        for (const auto& tech : roster) {
+            buckets.back().insert({tech.second, static_cast<int>(names.size())});
+            names.push_back(tech.first);
+            initialLoads.push_back(tech.second);
+        }
+    }
+    if (tickets.empty() || names.empty()) {
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+
+    // Each ticket's nearest bucket, plus the one below it on a tie
+    vector<int> nearest(tickets.size());
+    vector<int> tiedBelow(tickets.size(), -1);
+    vector<int> groupOf(buckets.size());
+    for (size_t b = 0; b < buckets.size(); b++) {
+        groupOf[b] = static_cast<int>(b);
+    }
+    auto root = [&groupOf](int b) {
+        while (groupOf[b] != b) {
+            b = groupOf[b] = groupOf[groupOf[b]];
+        }
+        return b;
+    };
+    for (size_t t = 0; t < tickets.size(); t++) {
+        int complexity = repairRequests[tickets[t]].complexity;
+        int above = static_cast<int>(lower_bound(expertiseLevels.begin(), expertiseLevels.end(), complexity) -
+                                     expertiseLevels.begin());
+        if (above == static_cast<int>(expertiseLevels.size())) {
+            nearest[t] = above - 1;
+        } else if (above == 0) {
+            nearest[t] = 0;
+        } else {
+            int belowGap = complexity - expertiseLevels[above - 1];
+            int aboveGap = expertiseLevels[above] - complexity;
+            nearest[t] = belowGap < aboveGap ? above - 1 : above;
+            if (belowGap == aboveGap) {
+                tiedBelow[t] = above - 1;
+                groupOf[root(above)] = root(above - 1);
             }
-        } else if (choice != 0) {
-            cout << "Invalid choice!" << endl;
         }
     }
-    pause();
+    vector<vector<size_t>> groupTickets(buckets.size()); // positions in `tickets`, in priority order
+    for (size_t t = 0; t < tickets.size(); t++) {
+        groupTickets[root(nearest[t])].push_back(t);
+    }
+
+    struct WorkQueue {
+        mutex lock;
+        deque<size_t> groups;
+    };
+    vector<WorkQueue> queues(stats.threads);
+    for (size_t g = 0, n = 0; g < groupTickets.size(); g++) {
+        if (!groupTickets[g].empty()) {
+            queues[n++ % stats.threads].groups.push_back(g);
+        }
+    }
+
+    vector<int> chosen(tickets.size(), -1);
+    atomic<size_t> steals(0);
+    auto worker = [&](unsigned self) {
+        TRACE_SPAN("assignWorker", "worker", self);
+        size_t group = 0;
+        while (true) {
+            bool found = false;
+            {
+                lock_guard<mutex> lock(queues[self].lock);
+                if (!queues[self].groups.empty()) {
+                    group = queues[self].groups.back();
+                    queues[self].groups.pop_back();
+                    found = true;
+                }
+            }
+            for (unsigned k = 1; !found && k < stats.threads; k++) {
+                WorkQueue& victim = queues[(self + k) % stats.threads];
+                lock_guard<mutex> lock(victim.lock);
+                if (!victim.groups.empty()) {
+                    group = victim.groups.front();
+                    victim.groups.pop_front();
+                    steals.fetch_add(1, memory_order_relaxed);
+                    found = true;
+                }
+            }
+            if (!found) {
+                return; // no work is added once the batch starts
+            }
+
+            // Only this worker touches the group's buckets
+            for (size_t t : groupTickets[group]) {
+                set<pair<int, int>>* bucket = &buckets[nearest[t]];
+                if (tiedBelow[t] >= 0 && buckets[tiedBelow[t]].begin()->first < bucket->begin()->first) {
+                    bucket = &buckets[tiedBelow[t]];
+                }
+                pair<int, int> head = *bucket->begin();
+                bucket->erase(bucket->begin());
+                bucket->insert({head.first + 1, head.second});
+                chosen[t] = head.second;
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 1; i < stats.threads; i++) {
+        workers.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto& w : workers) {
+        w.join();
+    }
+    stats.steals = steals.load();
+
+    // Every queued ticket was assigned, so the queue empties in one step
+    repairQueue.clear();
+    for (size_t t = 0; t < tickets.size(); t++) {
+        RepairRequest& req = repairRequests[tickets[t]];
+        req.assignedTechnician = names[chosen[t]];
+        repairsByStatus.move(tickets[t], req.status, REPAIR_ASSIGNED);
+        req.status = REPAIR_ASSIGNED;
+        journalRepairAssigned(tickets[t]);
+    }
+    for (const auto& bucket : buckets) {
+        for (const auto& entry : bucket) {
+            int added = entry.first - initialLoads[entry.second];
+            if (added > 0) {
+                technicians.adjustLoad(names[entry.second], added);
+            }
+        }
+    }
+    stats.assigned = tickets.size();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
 }
 
-void displaySalesReport() {
-    clearScreen();
-    if (transactions.empty()) {
-        cout << "\nNo transactions recorded yet.\n" << endl;
+size_t recordRepairRequest(const string& itemName, const string& issue, int complexity, int serviceTier) {
+    RepairRequest request;
+    request.itemName = itemName;
+    request.issue = issue;
+    request.status = REPAIR_PENDING;
+    request.submissionTime = time(nullptr);
+    request.complexity = complexity;
+    request.serviceTier = validServiceTier(serviceTier);
+
+    repairRequests.push_back(request);
+    repairsByStatus.add(repairRequests.size() - 1, REPAIR_PENDING);
+    journalRepairAdded(request);
+    repairQueue.schedule(repairRequests.size() - 1, repairDueTime(request));
+    return repairRequests.size() - 1;
+}
+
+bool rescheduleRepair(size_t requestIndex, int complexity, int serviceTier) {
+    if (requestIndex >= repairRequests.size()) {
+        return false;
+    }
+    RepairRequest& req = repairRequests[requestIndex];
+    req.complexity = complexity;
+    req.serviceTier = validServiceTier(serviceTier);
+    journalRepairPriority(requestIndex);
+    repairQueue.reprioritize(requestIndex, repairDueTime(req));
+    return true;
+}
+
+// Moves a ticket along the repair state machine, keeping the queue,
+// technician loads and status buckets in step. Assigned is reached only
+// through assignNextRepair(), which picks the technician.
+bool setRepairStatus(size_t requestIndex, RepairStatus status) {
+    if (requestIndex >= repairRequests.size() || status == REPAIR_ASSIGNED) {
+        return false;
+    }
+    RepairRequest& req = repairRequests[requestIndex];
+    RepairStatus previous = req.status;
+    if (!REPAIR_TRANSITIONS[previous][status]) {
+        return false;
+    }
+    bool wasLoad = !req.assignedTechnician.empty() && previous != REPAIR_COMPLETED;
+    req.status = status;
+    repairsByStatus.move(requestIndex, previous, status);
+    if (status == REPAIR_PENDING && !req.assignedTechnician.empty()) {
+        // Back in the queue for whoever is free next
+        if (wasLoad) {
+            technicians.adjustLoad(req.assignedTechnician, -1);
+        }
+        req.assignedTechnician.clear();
+        journalRepairAssigned(requestIndex);
     } else {
-        int totalRevenue = 0;
-        cout << "\n--- Sales Report ---" << endl;
-        cout << setw(5) << "No." << setw(25) << "Item" << setw(10) << "Price" 
-             << setw(25) << "Timestamp" << endl;
-        cout << string(65, '-') << endl;
-        
-        for (size_t i = 0; i < transactions.size(); i++) {
-            cout << setw(5) << i + 1 
-                 << setw(25) << transactions[i].itemName 
-                 << setw(10) << transactions[i].price
-                 << setw(25) << ctime(&transactions[i].timestamp);
-            totalRevenue += transactions[i].price;
+        journalRepairStatus(requestIndex);
+        bool isLoad = !req.assignedTechnician.empty() && status != REPAIR_COMPLETED;
+        if (wasLoad != isLoad) {
+            technicians.adjustLoad(req.assignedTechnician, isLoad ? 1 : -1);
         }
-        
-        cout << "\nTotal Revenue: P" << totalRevenue << endl;
     }
-    pause();
+    if (isRepairOpen(req)) {
+        repairQueue.schedule(requestIndex, repairDueTime(req));
+    } else {
+        repairQueue.cancel(requestIndex);
+    }
+    return true;
 }
 
-void displayInventoryStatus() {
-    clearScreen();
-    cout << "\n--- Inventory Status ---" << endl;
-    displayItems(inventory);
-    
-    int totalItems = 0;
-    int totalValue = 0;
-    for (const auto& item : inventory) {
-        totalItems += item.stock;
-        totalValue += item.price * item.stock;
+// Buckets are derived from the tickets, so they are rebuilt after loading
+void rebuildRepairStatusIndex() {
+    repairsByStatus.clear();
+    for (size_t i = 0; i < repairRequests.size(); i++) {
+        repairsByStatus.add(i, repairRequests[i].status);
     }
-    
-    cout << "\nTotal number of items in inventory: " << totalItems << endl;
-    cout << "Total value of inventory: P" << totalValue << endl;
-    pause();
 }
 
-void displayPopularItems() {
-    clearScreen();
-    cout << "\n--- Popular Items ---" << endl;
-    
-    map<string, int> itemSales;
-    for (const auto& transaction : transactions) {
-        itemSales[transaction.itemName]++;
+bool setPrintJobStatus(size_t jobIndex, PrintStatus status) {
+    if (jobIndex >= printJobs.size() || !PRINT_TRANSITIONS[printJobs[jobIndex].status][status]) {
+        return false;
     }
-    
-    vector<pair<string, int>> sortedSales(itemSales.begin(), itemSales.end());
-    sort(sortedSales.begin(), sortedSales.end(),
-         [](const pair<string, int>& a, const pair<string, int>& b) {
-             return a.second > b.second;
-         });
-    
-    cout << setw(5) << "Rank" << setw(25) << "Item" << setw(10) << "Sales" << endl;
-    cout << string(40, '-') << endl;
-    
-    for (size_t i = 0; i < min(sortedSales.size(), size_t(10)); i++) {
-        
-        cout << setw(5) << i + 1 
-             << setw(25) << sortedSales[i].first 
-             << setw(10) << sortedSales[i].second << endl;
+    printJobsByStatus.move(jobIndex, printJobs[jobIndex].status, status);
+    printJobs[jobIndex].status = status;
+    return true;
+}
+
+// "Pending: 3  Assigned: 1 ..." from per-state counts
+string formatStatusCounts(const string* names, const size_t* counts, size_t states) {
+    string text;
+    for (size_t state = 0; state < states; state++) {
+        text += (state ? "  " : "") + names[state] + ": " + to_string(counts[state]);
     }
-    pause();
+    return text;
 }
 
-void searchItems() {
-    string searchTerm;
-    clearScreen();
-    cout << "\n--- Search Items ---" << endl;
-    cout << "Enter search term: ";
-    cin.ignore();
-    getline(cin, searchTerm);
-    
-    transform(searchTerm.begin(), searchTerm.end(), searchTerm.begin(), ::tolower);
-    
-    vector<Item> searchResults;
-    for (const auto& item : inventory) {
-        string lowerName = item.name;
-        transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
-        if (lowerName.find(searchTerm) != string::npos) {
-            searchResults.push_back(item);
+bool createUser(const string& username, const string& password, bool isStudent) {
+    if (username.empty() || users.find(username) != users.end()) {
+        return false;
+    }
+    users[username] = {username, password, isStudent, 0};
+    journalUserRegistered(users[username]);
+    return true;
+}
+
+// Runs several simulated counters against one shared inventory until it
+// sells out, for 1, 2, 4, ... threads, and checks that nothing oversold.
+// It reseeds the live inventory, users and sales with synthetic data, so it
+// refuses to run once the journal is open, i.e. real shop data is loaded.
+bool runCheckoutStressTest(int maxThreads) {
+    if (journal.fd >= 0) {
+        cout << "Checkout stress test refused: the shop journal is open, so real data is loaded." << endl;
+        return false;
+    }
+    const int itemCount = 200;
+    const int unitsPerItem = 500;
+    bool allPassed = true;
+
+    cout << "Checkout stress test: " << itemCount << " items x " << unitsPerItem << " units" << endl;
+    cout << setw(8) << "Threads" << setw(14) << "Checkouts" << setw(12) << "Aborts"
+         << setw(14) << "Seconds" << setw(18) << "Checkouts/sec" << setw(8) << "Check" << endl;
+
+    for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        inventory.clear();
+        for (int i = 0; i < itemCount; i++) {
+            inventory.push_back({"Stress Item " + to_string(i + 1), "Refurbished", 100 + i, unitsPerItem, "Gadgets", {}, i + 1});
+        }
+        rebuildInventoryIndex();
+        transactions.clear();
+        users.clear();
+        // Counters get their User before any thread starts; looking them up
+        // through the shared map from the threads would race.
+        vector<User*> customers;
+        for (int t = 0; t < threadCount; t++) {
+            string name = "counter" + to_string(t + 1);
+            User& customer = users[name];
+            customer = {name, "", false, 0, {}, 0};
+            customers.push_back(&customer);
+        }
+
+        atomic<long long> remaining(static_cast<long long>(itemCount) * unitsPerItem);
+        atomic<long long> checkouts(0);
+        atomic<long long> aborts(0);
+        vector<thread> counters;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < threadCount; t++) {
+            counters.emplace_back([&, t] {
+                mt19937 gen(t + 1);
+                uniform_int_distribution<> pickItem(1, itemCount);
+                uniform_int_distribution<> pickOutcome(1, 10);
+                User& customer = *customers[t];
+                long long committed = 0, aborted = 0;
+                while (remaining.load(memory_order_relaxed) > 0) {
+                    CheckoutReservation reservation;
+                    int sku = pickItem(gen);
+                    if (!reserveStock(sku, 1, reservation)) {
+                        continue;
+                    }
+                    if (pickOutcome(gen) == 1) {
+                        abortReservation(reservation); // customer walked away
+                        aborted++;
+                    } else if (commitReservation(reservation, 100 + sku - 1, customer)) {
+                        remaining.fetch_sub(1, memory_order_relaxed);
+                        committed++;
+                    }
+                }
+                checkouts += committed;
+                aborts += aborted;
+            });
+        }
+        for (auto& counter : counters) {
+            counter.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        bool passed = transactions.size() == static_cast<size_t>(checkouts.load()) &&
+                      checkouts.load() == static_cast<long long>(itemCount) * unitsPerItem;
+        for (const auto& item : inventory) {
+            passed = passed && item.stock == 0 && item.reserved == 0;
         }
+        allPassed = allPassed && passed;
+
+        cout << setw(8) << threadCount << setw(14) << checkouts.load() << setw(12) << aborts.load()
+             << setw(14) << fixed << setprecision(3) << seconds << defaultfloat
+             << setw(18) << static_cast<long long>(checkouts.load() / seconds)
+             << setw(8) << (passed ? "OK" : "FAIL") << endl;
     }
-    
-    if (searchResults.empty()) {
-        cout << "No items found matching your search term." << endl;
-    } else {
-        cout << "\nSearch Results:" << endl;
-        displayItems(searchResults);
+    return allPassed;
+}
+
+// Text after the fixed arguments of a batch command, trimmed
+string batchRemainder(istringstream& args) {
+    string rest;
+    getline(args, rest);
+    size_t start = rest.find_first_not_of(" \t");
+    size_t end = rest.find_last_not_of(" \t\r");
+    return start == string::npos ? "" : rest.substr(start, end - start + 1);
+}
+
+// Archives the receipt for a completed sale; returns its ID, or 0 if it
+// could not be written. salesMutex keeps IDs in timestamp order.
+int issueReceipt(const Item& item, int price, int payment, const User& customer) {
+    TRACE_FUNCTION();
+    lock_guard<mutex> salesLock(salesMutex);
+    return receiptArchive.append({0, customer.username, item.name, item.condition, price, payment, payment - price,
+                                  customer.loyaltyPoints, time(nullptr)});
+}
+
+bool findReceipt(int receiptId, Receipt& receipt) {
+    return receiptArchive.find(receiptId, receipt);
+}
+
+string renderReceipt(const Receipt& receipt) {
+    TRACE_FUNCTION();
+    string text(receiptTemplate.size(), ' ');
+    receiptTemplate.render(receipt, &text[0]);
+    return text;
+}
+
+// Renders receipts back to back from byte `at`; receipt i starts at
+// at + i * receiptTemplate.size(). Returns the offset just past the last one.
+// The arena only grows, so repeated batches reuse one allocation.
+size_t renderReceipts(const Receipt* first, size_t count, vector<char>& arena, size_t at) {
+    size_t end = at + count * receiptTemplate.size();
+    if (arena.size() < end) {
+        arena.resize(end);
     }
-    pause();
+    char* out = arena.data() + at;
+    for (size_t i = 0; i < count; i++) {
+        out += receiptTemplate.render(first[i], out);
+    }
+    return end;
 }
 
-void redeemLoyaltyPoints(User& currentUser) {
-    clearScreen();
-    cout << "\n--- Redeem Loyalty Points ---" << endl;
-    cout << "You have " << currentUser.loyaltyPoints << " loyalty points." << endl;
-    
-    int pointsToRedeem;
-    cout << "Enter the number of points to redeem (100 points = P10 discount): ";
-    cin >> pointsToRedeem;
-    
-    if (cin.fail() || pointsToRedeem < 0) {
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        cout << "Invalid input. Please enter a positive number.\n";
-        pause();
-        return;
+// Local midnight at the start of the day containing `when`
+time_t localDayStart(time_t when) {
+    int64_t local = toLocalTime(when);
+    int64_t intoDay = local % 86400;
+    time_t start = when - static_cast<time_t>(intoDay < 0 ? intoDay + 86400 : intoDay);
+    // On a daylight saving day midnight had a different offset than `when`
+    return start + static_cast<time_t>(local - when - (toLocalTime(start) - start));
+}
+
+// "yyyy-mm-dd" to local midnight of that day
+bool parseDate(const string& text, time_t& dayStart) {
+    tm date = {};
+    char trailing;
+    if (sscanf(text.c_str(), "%d-%d-%d%c", &date.tm_year, &date.tm_mon, &date.tm_mday, &trailing) != 3 ||
+        date.tm_mon < 1 || date.tm_mon > 12 || date.tm_mday < 1 || date.tm_mday > 31) {
+        return false;
     }
-    
-    if (pointsToRedeem > currentUser.loyaltyPoints) {
-        cout << "You don't have enough points to redeem." << endl;
-    } else {
-        int discount = pointsToRedeem / 10;
-        currentUser.loyaltyPoints -= pointsToRedeem;
-        cout << "You've redeemed " << pointsToRedeem << " points for a P" << discount << " discount on your next purchase." << endl;
-        cout << "Remaining loyalty points: " << currentUser.loyaltyPoints << endl;
+    date.tm_year -= 1900;
+    date.tm_mon -= 1;
+    date.tm_hour = 12; // clear of any DST shift at midnight
+    date.tm_isdst = -1;
+    time_t noon = mktime(&date);
+    if (noon == -1) {
+        return false;
+    }
+    dayStart = localDayStart(noon);
+    return true;
+}
+
+// Mails every receipt issued on the local calendar day of `day` as one
+// message, e.g. to the shop's bookkeeping address at closing time. The day
+// is located by binary search and read a chunk at a time.
+bool queueDailyReceiptDigest(const string& to, time_t day, size_t& receiptCount) {
+    time_t dayStart = localDayStart(day);
+    uint32_t first = receiptArchive.firstAtOrAfter(dayStart);
+    uint32_t end = receiptArchive.firstAtOrAfter(dayStart + 86400);
+    receiptCount = end - first;
+    if (receiptCount == 0) {
+        return false;
+    }
+    vector<Receipt> chunk;
+    size_t bytes = 0;
+    for (uint32_t id = first; id < end; id += static_cast<uint32_t>(chunk.size())) {
+        if (receiptArchive.readRange(id, min<size_t>(RECEIPT_DIGEST_CHUNK, end - id), chunk) == 0) {
+            break;
+        }
+        bytes = renderReceipts(chunk.data(), chunk.size(), receiptArena, bytes);
+    }
+    char date[19];
+    formatDateTime(toLocalTime(dayStart), date);
+    return queueMail(to, "Receipts for " + string(date, 10), string(receiptArena.data(), bytes));
+}
+
+// Hands a message to the background mail queue; never waits on delivery
+bool queueMail(const string& to, const string& subject, const string& body) {
+    TRACE_FUNCTION();
+    size_t at = to.find('@');
+    if (at == string::npos || at == 0 || at + 1 == to.size() || to.find_first_of(" \t\r\n") != string::npos) {
+        return false;
+    }
+    return mailQueue.enqueue(to, subject, body);
+}
+
+bool queueRepairConfirmation(const string& to, size_t requestIndex) {
+    const RepairRequest& request = repairRequests[requestIndex];
+    ostringstream body;
+    body << "We received your repair request #" << requestIndex + 1 << ".\n";
+    body << "Item: " << request.itemName << "\n";
+    body << "Issue: " << request.issue << "\n";
+    body << "Coverage: " << TIER_NAMES[request.serviceTier] << "\n";
+    body << "Status: " << request.status << "\n";
+    return queueMail(to, "Repair request #" + to_string(requestIndex + 1) + " received", body.str());
+}
+
+// Reads an optional address on its own line after a numeric prompt
+string promptEmailAddress(const string& prompt) {
+    TRACE_FUNCTION();
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    cout << prompt;
+    string email;
+    getline(cin, email);
+    cin.putback('\n'); // pause() discards the rest of the current line first
+    email.erase(0, email.find_first_not_of(" \t"));
+    email.erase(email.find_last_not_of(" \t\r") + 1);
+    return email;
+}
+
+// Waits out a simulated step whose result the service needs next. Other
+// services' completions keep running meanwhile.
+void runServiceStep(chrono::milliseconds duration) {
+    bool done = false;
+    serviceScheduler.after(duration, [&done] { done = true; });
+    while (!done) {
+        serviceScheduler.runNext();
     }
-    pause();
 }
 
-void saveDataToFile() {
-    ofstream outFile("shop_data.txt");
-    if (outFile.is_open()) {
-        // Save inventory
-        outFile << inventory.size() << endl;
-        for (const auto& item : inventory) {
-            outFile << item.name << "|" << item.condition << "|" << item.price << "|" << item.stock << "|" << item.category << endl;
-        }
-        
-        // Save transactions
-        outFile << transactions.size() << endl;
-        for (const auto& trans : transactions) {
-            outFile << trans.itemName << "|" << trans.price << "|" << trans.timestamp << endl;
-        }
-        
-        // Save repair requests
-        outFile << repairRequests.size() << endl;
-        for (const auto& req : repairRequests) {
-            outFile << req.itemName << "|" << req.issue << "|" << req.status << "|" << req.submissionTime << endl;
-        }
-        
-        // Save user accounts
-        outFile << users.size() << endl;
-        for (const auto& user : users) {
-            outFile << user.first << "|" << user.second.password << "|" << user.second.isStudent << "|" << user.second.loyaltyPoints << endl;
-        }
-        
-        outFile.close();
-        cout << "Data saved successfully!" << endl;
-    } else {
-        cout << "Unable to save data to file." << endl;
+// Lets a simulated step finish on its own while the customer carries on;
+// `notice` appears on the menu once it has
+void finishServiceInBackground(chrono::milliseconds duration, const string& notice) {
+    serviceScheduler.after(duration, [notice] { serviceNotices.push_back(notice); });
+}
+
+void showServiceNotices() {
+    serviceScheduler.catchUp();
+    for (const auto& notice : serviceNotices) {
+        cout << "* " << notice << endl;
     }
+    serviceNotices.clear();
 }
 
-void loadDataFromFile() {
-    ifstream inFile("shop_data.txt");
-    if (inFile.is_open()) {
-        string line;
-        int count;
-        
-        // Load inventory
-        inFile >> count;
-        inFile.ignore();
-        inventory.clear();
-        for (int i = 0; i < count; i++) {
-            getline(inFile, line);
-            istringstream iss(line);
-            string name, condition, category;
-            int price, stock;
-            getline(iss, name, '|');
-            getline(iss, condition, '|');
-            iss >> price;
-            iss.ignore();
-            iss >> stock;
-            iss.ignore();
-            getline(iss, category);
-            inventory.push_back({name, condition, price, stock, category});
-        }
-        
-        // Load transactions
-        inFile >> count;
-        inFile.ignore();
-        transactions.clear();
-        for (int i = 0; i < count; i++) {
-            getline(inFile, line);
-            istringstream iss(line);
-            string itemName;
-            int price;
-            time_t timestamp;
-            getline(iss, itemName, '|');
-            iss >> price;
-            iss.ignore();
-            iss >> timestamp;
-            transactions.push_back({itemName, price, timestamp});
+// Executes line-delimited shop commands without the menus, one result line
+// per command:
+//
+//   BUY <sku> <payment> <username> [email]
+//   STOCK <sku> <quantity>
+//   ADD <price> <stock> <category> <name>|<condition>
+//   REPAIR <item name>|<issue>[|<complexity 1-10>[|<tier 0-2>[|<email>]]]
+//   PRIORITY <request no.> <complexity> <tier 0-2>
+//   TECHNICIAN <username> <expertise, 0 to stop taking repairs>
+//   ASSIGN [ALL | PARALLEL [threads]]
+//   STATUS <request no.> <pending|in progress|completed>
+//   REPAIRS <pending|assigned|in progress|completed>
+//   REGISTER <username> <password> <student 0/1>
+//   RECEIPT <receipt id>
+//   DIGEST <email> [yyyy-mm-dd]  (mails a day's receipts, default today, as one message)
+//   SEARCH <term>
+//   DIAGNOSE <devices> [sessions [device type 1-4]]  (files repairs for failures)
+//   WARRANTY <serial> [days]     (appends a registration to the ledger)
+//   PROOF <serial>
+//   AUDIT [threads]
+//   MEMORY                       (action arena counters)
+//   STATS                        (latency and allocations per measured operation)
+//   TRACE <on|off>               (timeline of spans in shop_trace.json)
+//
+// Each result is "OK <line> <COMMAND> key=value..." or
+// "ERR <line> <COMMAND> <reason>", followed by a final DONE summary.
+// Blank lines and lines starting with '#' are skipped.
+bool runBatch(istream& in) {
+    string line;
+    size_t lineNumber = 0, succeeded = 0, failed = 0;
+
+    while (getline(in, line)) {
+        lineNumber++;
+        istringstream args(line);
+        string command;
+        if (!(args >> command) || command[0] == '#') {
+            continue;
         }
-        
-        // Load repair requests
-        inFile >> count;
-        inFile.ignore();
-        repairRequests.clear();
-        for (int i = 0; i < count; i++) {
-            getline(inFile, line);
-            istringstream iss(line);
-            string itemName, issue, status;
-            time_t submissionTime;
-            getline(iss, itemName, '|');
-            getline(iss, issue, '|');
-            getline(iss, status, '|');
-            iss >> submissionTime;
-            repairRequests.push_back({itemName, issue, status, submissionTime});
-        }
-        
-        // Load user accounts
-        inFile >> count;
-        inFile.ignore();
-        users.clear();
-        for (int i = 0; i < count; i++) {
-            getline(inFile, line);
-            istringstream iss(line);
+        transform(command.begin(), command.end(), command.begin(), ::toupper);
+        TRACE_NAMED_SPAN(commandSpan, "batchCommand", "line", static_cast<int64_t>(lineNumber));
+
+        string error;
+        ostringstream result;
+        if (command == "BUY") {
+            int sku, payment;
+            string username, email;
+            if (!(args >> sku >> payment >> username)) {
+                error = "bad_arguments";
+            } else if (users.find(username) == users.end()) {
+                error = "unknown_user";
+            } else {
+                User& customer = users[username];
+                SaleOutcome sale = sellItem(sku, payment, customer.isStudent, customer);
+                switch (sale.status) {
+                    case SALE_OK: {
+                        result << "sku=" << sku << " price=" << sale.price << " change=" << sale.change
+                               << " points=" << customer.loyaltyPoints;
+                        result << " receipt=" << sale.receiptId;
+                        Receipt issued;
+                        if (args >> email && findReceipt(sale.receiptId, issued)) {
+                            string receipt = renderReceipt(issued);
+                            result << " mail=" << (queueMail(email, "Your T.I.P. Shop receipt", receipt) ? "queued" : "rejected");
+                        }
+                        break;
+                    }
+                    case SALE_UNKNOWN_ITEM: error = "unknown_sku"; break;
+                    case SALE_OUT_OF_STOCK: error = "out_of_stock"; break;
+                    case SALE_INSUFFICIENT_PAYMENT: error = "insufficient_payment price=" + to_string(sale.price); break;
+                }
+            }
+        } else if (command == "STOCK") {
+            int sku, quantity;
+            if (!(args >> sku >> quantity) || quantity < 0) {
+                error = "bad_arguments";
+            } else if (!restockItem(sku, quantity)) {
+                error = "unknown_sku";
+            } else {
+                result << "sku=" << sku << " stock=" << findItemBySku(sku)->stock;
+            }
+        } else if (command == "ADD") {
+            Item item;
+            string category, fields;
+            if (!(args >> item.price >> item.stock >> category) || item.price < 0 || item.stock < 0 ||
+                (fields = batchRemainder(args)).empty()) {
+                error = "bad_arguments";
+            } else {
+                item.category = category;
+                size_t bar = fields.find('|');
+                item.name = fields.substr(0, bar);
+                item.condition = bar == string::npos ? "" : fields.substr(bar + 1);
+                size_t position = createItem(item);
+                result << "sku=" << inventory[position].sku;
+            }
+        } else if (command == "REPAIR") {
+            vector<string> fields;
+            istringstream remainder(batchRemainder(args));
+            for (string field; getline(remainder, field, '|');) {
+                fields.push_back(field);
+            }
+            int complexity = fields.size() > 2 ? atoi(fields[2].c_str()) : DEFAULT_REPAIR_COMPLEXITY;
+            int serviceTier = fields.size() > 3 ? atoi(fields[3].c_str()) : TIER_STANDARD;
+            if (fields.size() < 2 || fields[0].empty() || complexity <= 0 || validServiceTier(serviceTier) != serviceTier) {
+                error = "bad_arguments";
+            } else {
+                size_t requestIndex = recordRepairRequest(fields[0], fields[1], complexity, serviceTier);
+                result << "request=" << requestIndex + 1 << " queued=" << repairQueue.size();
+                if (fields.size() > 4 && !fields[4].empty()) {
+                    result << " mail=" << (queueRepairConfirmation(fields[4], requestIndex) ? "queued" : "rejected");
+                }
+            }
+        } else if (command == "PRIORITY") {
+            size_t requestNumber;
+            int complexity, serviceTier;
+            if (!(args >> requestNumber >> complexity >> serviceTier) || requestNumber == 0 || complexity <= 0 ||
+                validServiceTier(serviceTier) != serviceTier) {
+                error = "bad_arguments";
+            } else if (!rescheduleRepair(requestNumber - 1, complexity, serviceTier)) {
+                error = "unknown_request";
+            } else {
+                result << "request=" << requestNumber << " queued=" << (repairQueue.contains(requestNumber - 1) ? 1 : 0);
+            }
+        } else if (command == "TECHNICIAN") {
+            string username;
+            int expertise;
+            if (!(args >> username >> expertise) || expertise < 0) {
+                error = "bad_arguments";
+            } else if (!setTechnicianExpertise(username, expertise)) {
+                error = "unknown_user";
+            } else {
+                result << "user=" << username << " expertise=" << expertise;
+            }
+        } else if (command == "ASSIGN") {
+            string scope;
+            args >> scope;
+            transform(scope.begin(), scope.end(), scope.begin(), ::toupper);
+            if (scope == "ALL") {
+                size_t assigned = assignQueuedRepairs();
+                result << "assigned=" << assigned << " queued=" << repairQueue.size();
+            } else if (scope == "PARALLEL") {
+                unsigned threadCount = 0;
+                if (!(args >> threadCount)) {
+                    threadCount = max(1u, thread::hardware_concurrency());
+                }
+                BatchAssignStats batch = assignQueuedRepairsParallel(threadCount);
+                result << "assigned=" << batch.assigned << " queued=" << repairQueue.size()
+                       << " threads=" << batch.threads << " steals=" << batch.steals
+                       << " per_sec=" << static_cast<long long>(batch.seconds > 0 ? batch.assigned / batch.seconds : 0);
+            } else if (!scope.empty()) {
+                error = "bad_arguments";
+            } else {
+                int requestIndex = assignNextRepair();
+                if (requestIndex < 0) {
+                    error = repairQueue.empty() ? "queue_empty" : "no_technician";
+                } else {
+                    result << "request=" << requestIndex + 1 << " technician="
+                           << repairRequests[requestIndex].assignedTechnician;
+                }
+            }
+        } else if (command == "STATUS") {
+            size_t requestNumber;
+            RepairStatus status;
+            if (!(args >> requestNumber) || requestNumber == 0) {
+                error = "bad_arguments";
+            } else if (!parseRepairStatus(batchRemainder(args), status)) {
+                error = "bad_status";
+            } else if (requestNumber > repairRequests.size()) {
+                error = "unknown_request";
+            } else if (!setRepairStatus(requestNumber - 1, status)) {
+                error = "bad_transition from=" + REPAIR_STATUS_NAMES[repairRequests[requestNumber - 1].status];
+            } else {
+                result << "request=" << requestNumber << " status=" << repairRequests[requestNumber - 1].status;
+            }
+        } else if (command == "REPAIRS") {
+            RepairStatus status;
+            if (!parseRepairStatus(batchRemainder(args), status)) {
+                error = "bad_status";
+            } else {
+                // Read straight from the status bucket, listed in request order
+                vector<size_t> members = repairsByStatus.in(status);
+                sort(members.begin(), members.end());
+                result << "status=" << status << " count=" << members.size() << " requests=";
+                for (size_t i = 0; i < members.size(); i++) {
+                    result << (i ? "," : "") << members[i] + 1;
+                }
+            }
+        } else if (command == "REGISTER") {
             string username, password;
-            bool isStudent;
-            int loyaltyPoints;
-            getline(iss, username, '|');
-            getline(iss, password, '|');
-            iss >> isStudent;
-            iss.ignore();
-            iss >> loyaltyPoints;
-            users[username] = {username, password, isStudent, loyaltyPoints};
+            int isStudent;
+            if (!(args >> username >> password >> isStudent)) {
+                error = "bad_arguments";
+            } else if (!createUser(username, password, isStudent != 0)) {
+                error = "user_exists";
+            } else {
+                result << "user=" << username;
+            }
+        } else if (command == "RECEIPT") {
+            int receiptId;
+            Receipt receipt;
+            if (!(args >> receiptId)) {
+                error = "bad_arguments";
+            } else if (!findReceipt(receiptId, receipt)) {
+                error = "unknown_receipt";
+            } else {
+                char date[19];
+                formatDateTime(toLocalTime(receipt.timestamp), date);
+                result << "receipt=" << receipt.id << " user=" << receipt.username << " price=" << receipt.price
+                       << " payment=" << receipt.payment << " change=" << receipt.change << " date="
+                       << string(date, 10) << "T" << string(date + 11, 8);
+            }
+        } else if (command == "DIGEST") {
+            string email, dateText;
+            time_t day = time(nullptr);
+            size_t receiptCount;
+            if (!(args >> email) || (args >> dateText && !parseDate(dateText, day))) {
+                error = "bad_arguments";
+            } else if (!queueDailyReceiptDigest(email, day, receiptCount)) {
+                error = receiptCount == 0 ? "no_receipts" : "mail_rejected";
+            } else {
+                result << "receipts=" << receiptCount << " mail=queued";
+            }
+        } else if (command == "SEARCH") {
+            string term;
+            getline(args >> ws, term);
+            if (term.empty()) {
+                error = "bad_arguments";
+            } else {
+                MEASURE_OPERATION(OP_SEARCH_ITEMS);
+                pmr::vector<int> matches = findMatchingItems(term);
+                result << "matches=" << matches.size() << " skus=";
+                for (size_t i = 0; i < matches.size(); i++) {
+                    result << (i ? "," : "") << inventory[matches[i]].sku;
+                }
+            }
+        } else if (command == "DIAGNOSE") {
+            int count = 0, sessions = 1, type = DEVICE_LAPTOP + 1;
+            bool valid = args >> count && count > 0;
+            if (valid && !(args >> ws).eof()) {
+                valid = args >> sessions && sessions > 0;
+            }
+            if (valid && !(args >> ws).eof()) {
+                valid = static_cast<bool>(args >> type);
+            }
+            if (!valid) {
+                error = "bad_arguments";
+            } else {
+                DiagnosticsRun run;
+                run.devices.assign(count, type >= 1 && type <= DEVICE_TYPE_COUNT ? static_cast<DeviceType>(type - 1)
+                                                                                 : DEVICE_OTHER);
+                run.concurrency = min<size_t>(sessions, DIAGNOSTIC_MAX_SESSIONS);
+                size_t failed = 0;
+                run.onResult = [&failed](const DiagnosticResult& result) { failed += result.issues != 0; };
+                runDiagnostics(run);
+                double minutes = (serviceScheduler.clock.nowMs() - run.startMs) / 60000.0;
+                result << "devices=" << count << " sessions=" << run.concurrency << " failed=" << failed
+                       << " repairs_filed=" << failed << fixed << setprecision(1) << " minutes=" << minutes
+                       << " per_minute=" << (minutes > 0 ? count / minutes : 0.0);
+            }
+        } else if (command == "WARRANTY") {
+            string serial;
+            uint32_t days = WARRANTY_DEFAULT_DAYS;
+            if (!(args >> serial) || (!(args >> ws).eof() && !(args >> days))) {
+                error = "bad_arguments";
+            } else if (uint32_t sequence = warrantyLedger.append(serial, days, time(nullptr))) {
+                result << "serial=" << serial << " record=" << sequence << " hash=" << toHex(warrantyLedger.hashes.back(), 8);
+            } else {
+                error = "ledger_unavailable";
+            }
+        } else if (command == "PROOF") {
+            string serial;
+            WarrantyProof proof;
+            if (!(args >> serial)) {
+                error = "bad_arguments";
+            } else if (!warrantyLedger.prove(serial, proof)) {
+                error = "unknown_serial";
+            } else if (!proof.valid) {
+                error = "proof_failed record=" + to_string(proof.record.sequence);
+            } else {
+                result << "serial=" << serial << " record=" << proof.record.sequence << " expires="
+                       << formatDate(proof.record.expires()) << " via="
+                       << (proof.checkpointed ? "checkpoint" : "chain") << " hashes=" << proof.hashes;
+            }
+        } else if (command == "AUDIT") {
+            unsigned threadCount = max(1u, thread::hardware_concurrency());
+            if (!(args >> ws).eof() && !(args >> threadCount)) {
+                error = "bad_arguments";
+            } else {
+                WarrantyAudit audit = warrantyLedger.audit(threadCount);
+                if (audit.firstBadRecord != 0) {
+                    error = "verification_failed record=" + to_string(audit.firstBadRecord);
+                } else {
+                    result << "records=" << audit.records << " blocks=" << audit.blocks << " threads=" << audit.threads
+                           << fixed << setprecision(3) << " seconds=" << audit.seconds;
+                }
+            }
+        } else if (command == "STATS") {
+            for (int op = 0; op < OPERATION_COUNT; op++) {
+                const LatencyHistogram& stats = operationStats[op];
+                uint64_t count = stats.count.load(memory_order_relaxed);
+                if (count > 0) {
+                    result << (result.tellp() > 0 ? " " : "") << OPERATION_NAMES[op] << "=count:" << count
+                           << ",p50_us:" << formatMicros(stats.percentile(0.50))
+                           << ",p99_us:" << formatMicros(stats.percentile(0.99))
+                           << ",max_us:" << formatMicros(stats.maxNs.load(memory_order_relaxed))
+                           << ",allocs:" << fixed << setprecision(1)
+                           << double(stats.allocations.load(memory_order_relaxed)) / count << defaultfloat;
+                }
+            }
+        } else if (command == "TRACE") {
+            string mode;
+            args >> mode;
+            transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
+            if (mode == "ON") {
+                if (startTracing()) {
+                    result << "tracing=on file=" << TRACE_FILE;
+                } else {
+                    error = "cannot_open";
+                }
+            } else if (mode == "OFF") {
+                size_t events = stopTracing();
+                result << "tracing=off events=" << events
+                       << " dropped=" << traceWriter.droppedTotal() - traceWriter.droppedAtStart;
+            } else {
+                error = "bad_arguments";
+            }
+        } else if (command == "MEMORY") {
+            // Counts before this command's own reset
+            const ActionArena& arena = actionArena();
+            result << "actions=" << arena.actions << " allocations=" << arena.allocations
+                   << " bytes=" << arena.bytesAllocated << " heap_allocations=" << arena.heapAllocations
+                   << " peak_bytes=" << arena.peakBytes << " block_bytes=" << arena.block.size();
+        } else {
+            error = "unknown_command";
         }
-        
-        inFile.close();
-        cout << "Data loaded successfully!" << endl;
-    } else {
-        cout << "No saved data found. Starting with empty inventory and user base." << endl;
+
+        if (error.empty()) {
+            succeeded++;
+            cout << "OK " << lineNumber << " " << command << " " << result.str() << "\n";
+        } else {
+            failed++;
+            cout << "ERR " << lineNumber << " " << command << " " << error << "\n";
+        }
+        END_TRACE_SPAN(commandSpan);
+        maybeCompactJournal();
+        maybeDumpOperationStats();
+        flushTrace();
+        actionArena().reset();
     }
+    syncJournal();
+    cout << "DONE commands=" << succeeded + failed << " ok=" << succeeded << " failed=" << failed << endl;
+    return failed == 0;
 }
 
 void registerUser() {
+    TRACE_FUNCTION();
     string username, password;
     bool isStudent;
     
@@ -631,12 +6507,13 @@ void registerUser() {
     cout << "Are you a student? (1 for Yes, 0 for No): ";
     cin >> isStudent;
     
-    users[username] = {username, password, isStudent, 0};
+    createUser(username, password, isStudent);
     cout << "User registered successfully!" << endl;
     pause();
 }
 
 User* loginUser() {
+    TRACE_FUNCTION();
     string username, password;
     
     clearScreen();
@@ -658,6 +6535,7 @@ User* loginUser() {
 }
 
 void offerTradeIn(User& currentUser) {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Trade-In Offer ---" << endl;
     
@@ -681,11 +6559,9 @@ void offerTradeIn(User& currentUser) {
         int tradeInValue = 0;
 
         // Find the item in the inventory to determine its value
-        for (const auto& item : inventory) {
-            if (item.name == itemToTradeIn) {
-                tradeInValue = item.price * 0.4; // Offer 40% of the original price
-                break;
-            }
+        const Item* item = findItemByName(itemToTradeIn);
+        if (item) {
+            tradeInValue = item->price * 0.4; // Offer 40% of the original price
         }
 
         cout << "We can offer you P" << tradeInValue << " for your " << itemToTradeIn << "." << endl;
@@ -695,6 +6571,7 @@ void offerTradeIn(User& currentUser) {
 
         if (accept) {
             currentUser.loyaltyPoints += tradeInValue; // Add trade-in value as loyalty points
+            journalLoyaltyPoints(currentUser);
             cout << "Trade-in successful! P" << tradeInValue << " has been added to your loyalty points." << endl;
             currentUser.purchaseHistory.erase(currentUser.purchaseHistory.begin() + choice - 1);
         } else {
@@ -707,10 +6584,11 @@ void offerTradeIn(User& currentUser) {
 }
 
 void conductVirtualRepairSession() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Virtual Repair Session ---" << endl;
     cout << "Initiating virtual repair session..." << endl;
-    this_thread::sleep_for(chrono::seconds(2));
+    runServiceStep(chrono::seconds(2));
 
     cout << "Please describe the issue with your device: ";
     string issue;
@@ -718,7 +6596,7 @@ void conductVirtualRepairSession() {
     getline(cin, issue);
 
     cout << "\nAnalyzing issue..." << endl;
-    this_thread::sleep_for(chrono::seconds(3));
+    runServiceStep(chrono::seconds(3));
 
     cout << "\nBased on your description, here are some troubleshooting steps:" << endl;
     cout << "1. Check all cable connections" << endl;
@@ -745,6 +6623,7 @@ void conductVirtualRepairSession() {
 }
 
 void schedulePickupDelivery() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Schedule Pickup/Delivery ---" << endl;
     
@@ -780,6 +6659,7 @@ void schedulePickupDelivery() {
 }
 
 void displayUserDashboard(const User& user) {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- User Dashboard: " << user.username << " ---" << endl;
     cout << "Loyalty Points: " << user.loyaltyPoints << endl;
@@ -814,6 +6694,7 @@ void displayUserDashboard(const User& user) {
 }
 
 void generateQRCode(const string& data) {
+    TRACE_FUNCTION();
     cout << "Generating QR Code for: " << data << endl;
     // Simplified QR Code representation
     cout << "┌─────────┐" << endl;
@@ -826,13 +6707,14 @@ void generateQRCode(const string& data) {
 }
 
 void simulateIoTDeviceRepair() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- IoT Device Repair Simulation ---" << endl;
     cout << "Connecting to IoT device..." << endl;
-    this_thread::sleep_for(chrono::seconds(2));
+    runServiceStep(chrono::seconds(2));
 
     cout << "Device connected. Running diagnostics..." << endl;
-    this_thread::sleep_for(chrono::seconds(3));
+    runServiceStep(chrono::seconds(3));
 
     random_device rd;
     mt19937 gen(rd());
@@ -844,32 +6726,31 @@ void simulateIoTDeviceRepair() {
         case 1:
             cout << "Firmware outdated" << endl;
             cout << "Updating firmware..." << endl;
-            this_thread::sleep_for(chrono::seconds(5));
-            cout << "Firmware updated successfully." << endl;
+            finishServiceInBackground(chrono::seconds(5), "IoT repair: firmware updated successfully.");
             break;
         case 2:
             cout << "Sensor malfunction" << endl;
             cout << "Recalibrating sensors..." << endl;
-            this_thread::sleep_for(chrono::seconds(4));
-            cout << "Sensors recalibrated." << endl;
+            finishServiceInBackground(chrono::seconds(4), "IoT repair: sensors recalibrated.");
             break;
         case 3:
             cout << "Network connectivity problem" << endl;
             cout << "Resetting network module..." << endl;
-            this_thread::sleep_for(chrono::seconds(3));
-            cout << "Network module reset. Please reconnect the device to your network." << endl;
+            finishServiceInBackground(chrono::seconds(3),
+                                      "IoT repair: network module reset. Please reconnect the device to your network.");
             break;
     }
 
-    cout << "IoT device repair simulation complete." << endl;
+    cout << "The repair continues on the device; the menu will show when it is complete." << endl;
     pause();
 }
 
 void applyAugmentedRealityRepair() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Augmented Reality Repair Guide ---" << endl;
     cout << "Please put on your AR glasses and scan the QR code on your device." << endl;
-    this_thread::sleep_for(chrono::seconds(3));
+    runServiceStep(chrono::seconds(3));
 
     cout << "AR guide loaded. Follow these steps:" << endl;
     cout << "1. Locate the screws highlighted in red" << endl;
@@ -897,6 +6778,7 @@ void applyAugmentedRealityRepair() {
 }
 
 void offerSubscriptionService() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Repair Subscription Service ---" << endl;
     cout << "Subscribe to our repair service and enjoy these benefits:" << endl;
@@ -931,6 +6813,7 @@ void offerSubscriptionService() {
 }
 
 void provideRepairEstimate() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Repair Cost Estimator ---" << endl;
     
@@ -978,6 +6861,7 @@ void provideRepairEstimate() {
 }
 
 void offerRemoteDiagnostics() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Remote Diagnostics Service ---" << endl;
 
@@ -993,33 +6877,24 @@ void offerRemoteDiagnostics() {
     cin >> deviceType;
 
     cout << "Initiating remote connection..." << endl;
-    this_thread::sleep_for(chrono::seconds(3));
+    runServiceStep(chrono::seconds(3));
 
     cout << "Running system checks..." << endl;
-    this_thread::sleep_for(chrono::seconds(5));
+    runServiceStep(chrono::seconds(5));
 
     // Simulate diagnostic results
-    vector<string> issues;
     random_device rd;
     mt19937 gen(rd());
-    uniform_int_distribution<> dis(0, 3);
-    int issueCount = dis(gen);
-
-    for (int i = 0; i < issueCount; ++i) {
-        switch (dis(gen)) {
-            case 0: issues.push_back("Software update required"); break;
-            case 1: issues.push_back("Battery health degraded"); break;
-            case 2: issues.push_back("Storage space low"); break;
-            case 3: issues.push_back("Network connectivity issues"); break;
-        }
-    }
+    uint8_t issues = drawDiagnosticIssues(gen);
 
     cout << "\nDiagnostic Results:" << endl;
-    if (issues.empty()) {
+    if (issues == 0) {
         cout << "No issues detected. Your device appears to be functioning normally." << endl;
     } else {
-        for (const auto& issue : issues) {
-            cout << "- " << issue << endl;
+        for (size_t i = 0; i < DIAGNOSTIC_ISSUE_COUNT; ++i) {
+            if (issues & (1u << i)) {
+                cout << "- " << DIAGNOSTIC_ISSUES[i] << endl;
+            }
         }
         cout << "\nWould you like to schedule a repair for these issues? (1 for Yes, 0 for No): ";
         int scheduleRepair;
@@ -1032,7 +6907,111 @@ void offerRemoteDiagnostics() {
     pause();
 }
 
+// Zero to three distinct issues, as one bit each
+uint8_t drawDiagnosticIssues(mt19937& gen) {
+    uniform_int_distribution<> count(0, 3);
+    uniform_int_distribution<size_t> issue(0, DIAGNOSTIC_ISSUE_COUNT - 1);
+    uint8_t issues = 0;
+    for (int i = count(gen); i > 0; i--) {
+        issues |= static_cast<uint8_t>(1u << issue(gen));
+    }
+    return issues;
+}
+
+string describeDiagnosticIssues(uint8_t issues) {
+    string text;
+    for (size_t i = 0; i < DIAGNOSTIC_ISSUE_COUNT; i++) {
+        if (issues & (1u << i)) {
+            text += text.empty() ? "" : "; ";
+            text += DIAGNOSTIC_ISSUES[i];
+        }
+    }
+    return text;
+}
+
+// A device that fails its checks gets a repair request straight away, one
+// complexity point per issue found on top of a basic bench check
+void DiagnosticsRun::complete(ServiceScheduler& scheduler, size_t device) {
+    DiagnosticResult result;
+    result.device = device;
+    result.type = devices[device];
+    result.issues = drawDiagnosticIssues(gen);
+    result.elapsedMs = scheduler.clock.nowMs() - startMs;
+    if (result.issues) {
+        string itemName = string(DEVICE_TYPE_NAMES[result.type]) + " #" + to_string(device + 1) + " (cart)";
+        int complexity = 2 + 2 * static_cast<int>(bitset<8>(result.issues).count());
+        result.repairRequest = static_cast<int>(recordRepairRequest(itemName, describeDiagnosticIssues(result.issues),
+                                                                    complexity, TIER_STANDARD));
+    }
+    finished++;
+    if (onResult) {
+        onResult(result);
+    }
+    if (started < devices.size()) {
+        launch(scheduler);
+    }
+}
+
+// Diagnoses the whole cart, returning once every session has finished
+void runDiagnostics(DiagnosticsRun& run) {
+    TRACE_FUNCTION();
+    run.start(serviceScheduler);
+    while (!run.done()) {
+        serviceScheduler.runNext();
+    }
+}
+
+void diagnoseDeviceCart() {
+    TRACE_FUNCTION();
+    clearScreen();
+    cout << "\n--- Diagnose Device Cart ---" << endl;
+    cout << "Device type (1. Smartphone, 2. Laptop, 3. Smart Home Device, 4. Other): ";
+    int type;
+    cin >> type;
+    cout << "Number of devices on the cart: ";
+    int count;
+    cin >> count;
+    cout << "Sessions to run at once (1-" << DIAGNOSTIC_MAX_SESSIONS << "): ";
+    int sessions;
+    cin >> sessions;
+    if (cin.fail() || count <= 0 || sessions <= 0) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input." << endl;
+        pause();
+        return;
+    }
+
+    DiagnosticsRun run;
+    run.devices.assign(count, type >= 1 && type <= DEVICE_TYPE_COUNT ? static_cast<DeviceType>(type - 1) : DEVICE_OTHER);
+    run.concurrency = min<size_t>(sessions, DIAGNOSTIC_MAX_SESSIONS);
+    size_t failed = 0;
+    run.onResult = [&](const DiagnosticResult& result) {
+        cout << "[" << setw(4) << run.finished << "/" << run.devices.size() << "] " << fixed << setprecision(1)
+             << setw(7) << result.elapsedMs / 1000.0 << "s  " << DEVICE_TYPE_NAMES[result.type] << " #"
+             << result.device + 1 << ": " << defaultfloat;
+        if (result.issues) {
+            failed++;
+            cout << describeDiagnosticIssues(result.issues) << " -> repair request #" << result.repairRequest + 1;
+        } else {
+            cout << "OK";
+        }
+        cout << endl;
+    };
+    cout << "Diagnosing " << count << " devices, " << run.concurrency << " at a time..." << endl;
+    runDiagnostics(run);
+
+    double minutes = (serviceScheduler.clock.nowMs() - run.startMs) / 60000.0;
+    cout << "\n" << count << " devices diagnosed, " << failed << " repair requests filed";
+    if (minutes > 0) {
+        cout << " (" << fixed << setprecision(1) << count / minutes << " devices/minute)" << defaultfloat;
+    }
+    cout << endl;
+    pause();
+}
+
 void gamifyLoyaltyProgram(User& currentUser) {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Gamified Loyalty Program ---" << endl;
 
@@ -1066,6 +7045,9 @@ void gamifyLoyaltyProgram(User& currentUser) {
     cout << "\nQuiz Complete!" << endl;
     cout << "You got " << correctAnswers << " out of " << questions.size() << " correct." << endl;
     cout << "New Total Points: " << currentUser.loyaltyPoints << endl;
+    if (correctAnswers > 0) {
+        journalLoyaltyPoints(currentUser);
+    }
 
     // Check for level up
     int newLevel = currentUser.loyaltyPoints / 100; // Level up every 100 points
@@ -1080,75 +7062,62 @@ void gamifyLoyaltyProgram(User& currentUser) {
 }
 
 void displayRepairQueue() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Current Repair Queue ---" << endl;
     if (repairQueue.empty()) {
         cout << "No repairs currently in the queue." << endl;
     } else {
         int count = 1;
-        queue<RepairRequest> tempQueue = repairQueue;
-        while (!tempQueue.empty()) {
-            RepairRequest req = tempQueue.front();
-            cout << count << ". " << req.itemName << " - " << req.issue << " (Complexity: " << req.complexity << ")" << endl;
-            tempQueue.pop();
+        repairQueue.forEachInOrder([&count](size_t requestIndex) {
+            const RepairRequest& req = repairRequests[requestIndex];
+            cout << count << ". " << req.itemName << " - " << req.issue << " (Complexity: " << req.complexity
+                 << ", " << TIER_NAMES[req.serviceTier] << ")" << endl;
             count++;
-        }
+        });
     }
     pause();
 }
 
 void assignRepairTechnician() {
+    TRACE_FUNCTION();
     if (repairQueue.empty()) {
         cout << "No repairs in the queue to assign." << endl;
         return;
     }
 
-    RepairRequest req = repairQueue.front();
-    repairQueue.pop();
-
-    vector<pair<string, int>> availableTechnicians;
-    for (const auto& user : users) {
-        if (user.second.repairExpertise > 0) {
-            availableTechnicians.push_back({user.first, user.second.repairExpertise});
-        }
-    }
-
-    if (availableTechnicians.empty()) {
+    int requestIndex = assignNextRepair();
+    if (requestIndex < 0) {
         cout << "No technicians available. Repair request remains unassigned." << endl;
-        repairQueue.push(req);
         return;
     }
 
-    // Assign to the technician with the closest expertise level
-    sort(availableTechnicians.begin(), availableTechnicians.end(),
-         [&req](const pair<string, int>& a, const pair<string, int>& b) {
-             return abs(a.second - req.complexity) < abs(b.second - req.complexity);
-         });
-
-    req.assignedTechnician = availableTechnicians[0].first;
-    req.status = "Assigned";
-    repairRequests.push_back(req);
-
+    const RepairRequest& req = repairRequests[requestIndex];
     cout << "Repair for " << req.itemName << " assigned to " << req.assignedTechnician << endl;
 }
 
 void submit3DPrintJob() {
+    TRACE_FUNCTION();
     PrintJob job;
     cout << "Enter 3D model name: ";
     cin.ignore();
     getline(cin, job.modelName);
     cout << "Enter material (PLA/ABS/PETG): ";
-    cin >> job.material;
+    string material;
+    cin >> material;
+    job.material = material;
     cout << "Enter volume in cm³: ";
     cin >> job.volume;
-    job.status = "Queued";
+    job.status = PRINT_QUEUED;
 
     printJobs.push_back(job);
+    printJobsByStatus.add(printJobs.size() - 1, PRINT_QUEUED);
     cout << "3D print job submitted successfully!" << endl;
     pause();
 }
 
 void update3DPrintStatus() {
+    TRACE_FUNCTION();
     if (printJobs.empty()) {
         cout << "No active 3D print jobs." << endl;
         return;
@@ -1158,17 +7127,43 @@ void update3DPrintStatus() {
     for (size_t i = 0; i < printJobs.size(); ++i) {
         cout << i + 1 << ". " << printJobs[i].modelName << " - " << printJobs[i].status << endl;
     }
+    size_t counts[PRINT_STATUS_COUNT];
+    for (int status = 0; status < PRINT_STATUS_COUNT; status++) {
+        counts[status] = printJobsByStatus.count(status);
+    }
+    cout << formatStatusCounts(PRINT_STATUS_NAMES, counts, PRINT_STATUS_COUNT) << endl;
 
     int choice;
     cout << "Enter job number to update (0 to cancel): ";
     cin >> choice;
 
     if (choice > 0 && choice <= static_cast<int>(printJobs.size())) {
-        string newStatus;
-        cout << "Enter new status (Printing/Completed/Failed): ";
-        cin >> newStatus;
-        printJobs[choice - 1].status = newStatus;
-        cout << "Status updated successfully!" << endl;
+        PrintStatus current = printJobs[choice - 1].status;
+        vector<PrintStatus> options;
+        for (int next = 0; next < PRINT_STATUS_COUNT; next++) {
+            if (PRINT_TRANSITIONS[current][next]) {
+                options.push_back(static_cast<PrintStatus>(next));
+                cout << options.size() << ". " << PRINT_STATUS_NAMES[next] << endl;
+            }
+        }
+        if (options.empty()) {
+            cout << "This job is " << current << " and can no longer change." << endl;
+            pause();
+            return;
+        }
+        int option;
+        cout << "Choose the new status (0 to cancel): ";
+        cin >> option;
+        if (cin.fail()) {
+            cin.clear();
+            option = -1;
+        }
+        if (option > 0 && option <= static_cast<int>(options.size()) &&
+            setPrintJobStatus(choice - 1, options[option - 1])) {
+            cout << "Status updated successfully!" << endl;
+        } else if (option != 0) {
+            cout << "Invalid choice!" << endl;
+        }
     } else if (choice != 0) {
         cout << "Invalid choice!" << endl;
     }
@@ -1176,32 +7171,44 @@ void update3DPrintStatus() {
 }
 
 void displayRecyclingStats() {
+    TRACE_FUNCTION();
+    MEASURE_OPERATION(OP_RECYCLING_STATS);
     clearScreen();
     cout << "\n--- Recycling Statistics ---" << endl;
 
     if (recyclingRecords.empty()) {
         cout << "No recycling records available." << endl;
     } else {
+        const vector<string>& names = recyclingRecords.itemNames.names;
+        const uint32_t* itemIds = recyclingRecords.itemIds.data();
+        const float* weights = recyclingRecords.weights.data();
         float totalWeight = 0;
-        map<string, float> itemWeights;
+        vector<float> itemWeights(names.size(), 0.0f);
 
-        for (const auto& record : recyclingRecords) {
-            totalWeight += record.weight;
-            itemWeights[record.itemName] += record.weight;
+        for (size_t i = 0; i < recyclingRecords.size(); i++) {
+            totalWeight += weights[i];
+            itemWeights[itemIds[i]] += weights[i];
         }
 
         cout << "Total items recycled: " << recyclingRecords.size() << endl;
         cout << "Total weight recycled: " << totalWeight << " kg" << endl;
         cout << "\nBreakdown by item:" << endl;
 
-        for (const auto& item : itemWeights) {
-            cout << item.first << ": " << item.second << " kg" << endl;
+        vector<uint32_t> byName(names.size());
+        for (uint32_t id = 0; id < byName.size(); id++) {
+            byName[id] = id;
+        }
+        sort(byName.begin(), byName.end(), [&names](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+        for (uint32_t id : byName) {
+            cout << names[id] << ": " << itemWeights[id] << " kg" << endl;
         }
     }
+    END_OPERATION();
     pause();
 }
 
 void manageInventoryAlerts() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Inventory Alerts Management ---" << endl;
 
@@ -1225,7 +7232,11 @@ void manageInventoryAlerts() {
             for (auto& item : inventory) {
                 if (item.stock < 5) {
                     int reorderAmount = 10 - item.stock; // Reorder to bring stock up to 10
-                    item.stock += reorderAmount;
+                    {
+                        lock_guard<mutex> lock(stockLockFor(item.sku));
+                        item.stock += reorderAmount;
+                    }
+                    journalStockChange(item, reorderAmount);
                     cout << "Reordered " << reorderAmount << " units of " << item.name << endl;
                 }
             }
@@ -1236,61 +7247,285 @@ void manageInventoryAlerts() {
     pause();
 }
 
+string formatMicros(uint64_t ns) {
+    ostringstream text;
+    text << fixed << setprecision(1) << ns / 1000.0;
+    return text.str();
+}
+
+// One row per operation that has run since startup
+void printOperationStats(ostream& out) {
+#ifdef TIP_SHOP_NO_METRICS
+    out << "Operation stats are not compiled into this build." << endl;
+#else
+    out << left << setw(24) << "Operation" << right << setw(10) << "Count" << setw(12) << "p50 (us)" << setw(12)
+        << "p99 (us)" << setw(12) << "Max (us)" << setw(12) << "Mean (us)" << setw(11) << "Allocs/op" << endl;
+    out << string(93, '-') << endl;
+    bool any = false;
+    for (int op = 0; op < OPERATION_COUNT; op++) {
+        const LatencyHistogram& stats = operationStats[op];
+        uint64_t count = stats.count.load(memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+        any = true;
+        out << left << setw(24) << OPERATION_NAMES[op] << right << setw(10) << count << setw(12)
+            << formatMicros(stats.percentile(0.50)) << setw(12) << formatMicros(stats.percentile(0.99)) << setw(12)
+            << formatMicros(stats.maxNs.load(memory_order_relaxed)) << setw(12)
+            << formatMicros(stats.totalNs.load(memory_order_relaxed) / count) << setw(11) << fixed
+            << setprecision(1) << double(stats.allocations.load(memory_order_relaxed)) / count << defaultfloat
+            << endl;
+    }
+    if (!any) {
+        out << "No measured operations have run yet." << endl;
+    }
+#endif
+}
+
+void displayOperationStats() {
+    TRACE_FUNCTION();
+    clearScreen();
+    cout << "\n--- Operation Stats ---" << endl;
+    printOperationStats(cout);
+    cout << "\nTimes exclude waiting for input. Also written to " << OPERATION_STATS_FILE << "." << endl;
+    pause();
+}
+
+void dumpOperationStats() {
+#ifndef TIP_SHOP_NO_METRICS
+    ofstream out(OPERATION_STATS_FILE, ios::trunc);
+    char date[19];
+    formatDateTime(toLocalTime(time(nullptr)), date);
+    out << "T.I.P. Shop operation stats at " << string(date, sizeof(date)) << "\n\n";
+    printOperationStats(out);
+#endif
+}
+
+// Called between actions, like maybeCompactJournal()
+void maybeDumpOperationStats() {
+    static time_t lastDump = time(nullptr);
+    if (time(nullptr) - lastDump >= OPERATION_STATS_DUMP_SECONDS) {
+        dumpOperationStats();
+        lastDump = time(nullptr);
+    }
+}
+
+// Starts a fresh trace file; events buffered before now are discarded
+bool startTracing() {
+    lock_guard<mutex> guard(traceWriter.lock);
+    if (tracingEnabled.load()) {
+        return true;
+    }
+    traceWriter.out.open(TRACE_FILE, ios::trunc);
+    if (!traceWriter.out) {
+        traceWriter.out.close();
+        return false;
+    }
+    traceWriter.eventsWritten = 0;
+    traceWriter.ringsNamed = 0;
+    traceWriter.droppedAtStart = traceWriter.droppedTotal();
+    {
+        lock_guard<mutex> registryGuard(traceRegistry().lock);
+        for (unique_ptr<TraceRing>& ring : traceRegistry().rings) {
+            ring->tail.store(ring->head.load(memory_order_acquire), memory_order_release);
+        }
+    }
+    tracingEnabled.store(true);
+    return true;
+}
+
+// Writes out what is buffered and closes the file; returns the events written
+size_t stopTracing() {
+    lock_guard<mutex> guard(traceWriter.lock);
+    if (!tracingEnabled.load()) {
+        return 0;
+    }
+    tracingEnabled.store(false);
+    traceWriter.flushLocked();
+    traceWriter.out << (traceWriter.eventsWritten ? "\n]\n" : "[]\n");
+    traceWriter.out.close();
+    return traceWriter.eventsWritten;
+}
+
+// Called between actions, so a slow flush never lands inside a traced span
+void flushTrace() {
+    if (!tracingEnabled.load(memory_order_relaxed)) {
+        return;
+    }
+    lock_guard<mutex> guard(traceWriter.lock);
+    if (traceWriter.out.is_open()) {
+        traceWriter.flushLocked();
+    }
+}
+
+void toggleTracing() {
+    clearScreen();
+    cout << "\n--- Trace Timeline ---" << endl;
+#ifdef TIP_SHOP_NO_METRICS
+    cout << "Tracing is not compiled into this build." << endl;
+#else
+    if (tracingEnabled.load()) {
+        size_t events = stopTracing();
+        cout << "Tracing stopped. " << events << " events written to " << TRACE_FILE;
+        uint64_t dropped = traceWriter.droppedTotal() - traceWriter.droppedAtStart;
+        if (dropped > 0) {
+            cout << " (" << dropped << " dropped while a buffer was full)";
+        }
+        cout << "." << endl;
+        cout << "Open it in chrome://tracing or https://ui.perfetto.dev to see the timeline." << endl;
+    } else if (startTracing()) {
+        cout << "Tracing started. Each action is appended to " << TRACE_FILE
+             << " until tracing is stopped here or the shop exits." << endl;
+    } else {
+        cout << "Unable to open " << TRACE_FILE << " for writing." << endl;
+    }
+#endif
+    pause();
+}
+
+string formatDate(time_t timestamp) {
+    char date[19];
+    formatDateTime(toLocalTime(timestamp), date);
+    return string(date, 10);
+}
+
+void printWarrantyAudit(const WarrantyAudit& audit) {
+    cout << "Audited " << audit.records << " warranties in " << audit.blocks << " blocks on " << audit.threads
+         << " threads (" << fixed << setprecision(3) << audit.seconds << " s)" << defaultfloat << endl;
+    if (audit.firstBadRecord == 0) {
+        cout << "Every record, chain link and checkpoint verified." << endl;
+    } else {
+        cout << "VERIFICATION FAILED at record #" << audit.firstBadRecord << "; the ledger has been altered." << endl;
+    }
+}
+
 void implementBlockchainWarranty() {
+    TRACE_FUNCTION();
     clearScreen();
     cout << "\n--- Blockchain Warranty System ---" << endl;
+    cout << "Ledger: " << (warrantyLedger.open() ? warrantyLedger.size() : 0) << " registrations, "
+         << warrantyLedger.checkpoints.size() << " checkpoints" << endl;
+    cout << "1. Look up or register a warranty" << endl;
+    cout << "2. Audit the whole ledger" << endl;
+    cout << "Enter your choice: ";
+    int choice;
+    cin >> choice;
+
+    if (choice == 2) {
+        printWarrantyAudit(warrantyLedger.audit(max(1u, thread::hardware_concurrency())));
+        pause();
+        return;
+    }
+    if (choice != 1) {
+        cout << "Invalid choice!" << endl;
+        pause();
+        return;
+    }
 
     string itemSerial;
     cout << "Enter the item's serial number: ";
     cin.ignore();
     getline(cin, itemSerial);
-
-    // Simulate blockchain verification
-    cout << "Verifying warranty on the blockchain..." << endl;
-    this_thread::sleep_for(chrono::seconds(3));
-
-    // Generate a random warranty status for demonstration
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> dis(1, 3);
-    int warrantyStatus = dis(gen);
-
-    cout << "Blockchain verification complete." << endl;
-    cout << "Warranty status for item " << itemSerial << ": ";
-
-    switch (warrantyStatus) {
-        case 1:
-            cout << "Active - Valid until " << (time(nullptr) + 31536000) << endl; // 1 year from now
-            break;
-        case 2:
-            cout << "Expired - Warranty ended on " << (time(nullptr) - 2592000) << endl; // 1 month ago
-            break;
-        case 3:
-            cout << "Not found - Please register your product" << endl;
-            break;
+    cin.putback('\n'); // pause() discards the rest of the current line first
+    itemSerial.erase(0, itemSerial.find_first_not_of(" \t"));
+    itemSerial.erase(itemSerial.find_last_not_of(" \t\r") + 1);
+    if (itemSerial.empty()) {
+        cout << "A serial number is required." << endl;
+        pause();
+        return;
     }
 
-    if (warrantyStatus == 3) {
+    WarrantyProof proof;
+    bool renew = false;
+    if (warrantyLedger.prove(itemSerial, proof)) {
+        const WarrantyRecord& record = proof.record;
+        bool active = record.expires() > time(nullptr);
+        cout << "Warranty status for item " << itemSerial << ": "
+             << (active ? "Active - Valid until " : "Expired - Warranty ended on ") << formatDate(record.expires()) << endl;
+        cout << "Registered " << formatDate(static_cast<time_t>(record.registered)) << " as record #"
+             << record.sequence << " (hash " << toHex(record.hash, 8) << ")" << endl;
+        if (!proof.valid) {
+            cout << "PROOF FAILED: this record does not match the ledger; it has been altered." << endl;
+        } else if (proof.checkpointed) {
+            cout << "Proven against checkpoint " << proof.block + 1 << " with " << proof.hashes << " hashes." << endl;
+        } else {
+            cout << "Proven by the chain since the last checkpoint (" << proof.hashes << " hashes)." << endl;
+        }
+        if (!active && proof.valid) {
+            cout << "Would you like to renew this warranty for 1 year? (1 for Yes, 0 for No): ";
+            int renewWarranty;
+            cin >> renewWarranty;
+            renew = renewWarranty != 0;
+        }
+    } else {
+        cout << "Warranty status for item " << itemSerial << ": Not found - Please register your product" << endl;
         cout << "Would you like to register this product for warranty? (1 for Yes, 0 for No): ";
         int registerWarranty;
         cin >> registerWarranty;
+        renew = registerWarranty != 0;
+    }
 
-        if (registerWarranty) {
-            cout << "Registering warranty on the blockchain..." << endl;
-            this_thread::sleep_for(chrono::seconds(2));
-            cout << "Warranty registered successfully. Valid for 1 year from today." << endl;
+    if (renew) {
+        uint32_t sequence = warrantyLedger.append(itemSerial, WARRANTY_DEFAULT_DAYS, time(nullptr));
+        if (sequence == 0) {
+            cout << "Unable to write to the warranty ledger." << endl;
+        } else {
+            cout << "Warranty registered as record #" << sequence << ". Valid for 1 year from today." << endl;
         }
     }
 
     pause();
 }
 
-int main() {
+// The benchmark build compiles this file without main() and drives the
+// functions above directly
+#ifndef TIP_SHOP_NO_MAIN
+int main(int argc, char* argv[]) {
+    // Simulated services complete instantly, for scripted and test runs
+    if (argc > 1 && string(argv[1]) == "--virtual-time") {
+        serviceScheduler.clock.virtualTime = true;
+        argv++;
+        argc--;
+    }
+
+    if (argc > 1 && string(argv[1]) == "--stress-checkout") {
+        int maxThreads = argc > 2 ? atoi(argv[2]) : max(4u, thread::hardware_concurrency());
+        return runCheckoutStressTest(maxThreads) ? 0 : 1;
+    }
+
+    // Batch mode: commands from a file (or stdin) instead of the menus. Load
+    // and save messages go to stderr so stdout carries only command results.
+    if (argc > 1 && string(argv[1]) == "--batch") {
+        ifstream commandFile;
+        if (argc > 2 && string(argv[2]) != "-") {
+            commandFile.open(argv[2]);
+            if (!commandFile) {
+                cerr << "Unable to open " << argv[2] << endl;
+                return 2;
+            }
+        }
+        streambuf* console = cout.rdbuf(cerr.rdbuf());
+        loadDataFromFile();
+        cout.rdbuf(console);
+        mailQueue.start(unique_ptr<MailTransport>(new FileMailTransport(MAIL_OUTBOX_FILE)));
+        bool allSucceeded = runBatch(commandFile.is_open() ? static_cast<istream&>(commandFile) : cin);
+        mailQueue.stop();
+        cout.rdbuf(cerr.rdbuf());
+        saveDataToFile();
+        closeJournal();
+        dumpOperationStats();
+        stopTracing();
+        cout.rdbuf(console);
+        return allSucceeded ? 0 : 1;
+    }
+
     int choice;
     bool running = true;
     User* currentUser = nullptr;
 
+    terminal.attach();
     loadDataFromFile(); // Load saved data at the start
+    mailQueue.start(unique_ptr<MailTransport>(new FileMailTransport(MAIL_OUTBOX_FILE)));
 
     while (running) {
         clearScreen();
@@ -1299,114 +7534,159 @@ int main() {
         cout << "2. Login" << endl;
         cout << "3. Exit" << endl;
         cout << "Enter your choice: ";
-        cin >> choice;
+        {
+            TRACE_SPAN("waitForInput");
+            cin >> choice;
+        }
 
-        switch (choice) {
-            case 1:
-                registerUser();
-                break;
-            case 2:
-                currentUser = loginUser();
-                if (currentUser) {
-                    bool loggedIn = true;
-                    while (loggedIn) {
-                        clearScreen();
-                        cout << "Welcome, " << currentUser->username << "!" << endl;
-                        cout << "1. Buy Items" << endl;
-                        cout << "2. Submit Repair Request" << endl;
-                        cout << "3. View Repair Requests" << endl;
-                        cout << "4. Search Items" << endl;
-                        cout << "5. Redeem Loyalty Points" << endl;
-                        cout << "6. Trade-In Device" << endl;
-                        cout << "7. Virtual Repair Session" << endl;
-                        cout << "8. Schedule Pickup/Delivery" << endl;
-                        cout << "9. View Dashboard" << endl;
-                        cout << "10. Generate QR Code for Item" << endl;
-                        cout << "11. IoT Device Repair" << endl;
-                        cout << "12. Use AR Repair Guide" << endl;
-                        cout << "13. Repair Subscription Service" << endl;
-                        cout << "14. Get Repair Estimate" << endl;
-                        cout << "15. Remote Diagnostics" << endl;
-                        cout << "16. Participate in Loyalty Game" << endl;
+        // The session runs after this span closes, so it covers only the
+        // register or login itself
+        bool loggedIn = false;
+        {
+            TRACE_SPAN("mainMenuAction", "choice", choice);
+            switch (choice) {
+                case 1:
+                    registerUser();
+                    break;
+                case 2:
+                    currentUser = loginUser();
+                    loggedIn = currentUser != nullptr;
+                    break;
+                case 3:
+                    running = false;
+                    break;
+                default:
+                    cout << "Invalid choice!" << endl;
+                    pause();
+            }
+        }
+
+        while (loggedIn) {
+            clearScreen();
+            cout << "Welcome, " << currentUser->username << "!" << endl;
+            showServiceNotices();
+            cout << "1. Buy Items" << endl;
+            cout << "2. Submit Repair Request" << endl;
+            cout << "3. View Repair Requests" << endl;
+            cout << "4. Search Items" << endl;
+            cout << "5. Redeem Loyalty Points" << endl;
+            cout << "6. Trade-In Device" << endl;
+            cout << "7. Virtual Repair Session" << endl;
+            cout << "8. Schedule Pickup/Delivery" << endl;
+            cout << "9. View Dashboard" << endl;
+            cout << "10. Generate QR Code for Item" << endl;
+            cout << "11. IoT Device Repair" << endl;
+            cout << "12. Use AR Repair Guide" << endl;
+            cout << "13. Repair Subscription Service" << endl;
+            cout << "14. Get Repair Estimate" << endl;
+            cout << "15. Remote Diagnostics" << endl;
+            cout << "16. Participate in Loyalty Game" << endl;
+            if (currentUser->username == "admin") {
+                cout << "17. Add New Item" << endl;
+                cout << "18. Add Stock" << endl;
+                cout << "19. Update Repair Status" << endl;
+                cout << "20. View Sales Report" << endl;
+                cout << "21. View Inventory Status" << endl;
+                cout << "22. View Popular Items" << endl;
+                cout << "23. Manage Repair Queue" << endl;
+                cout << "24. Manage 3D Print Jobs" << endl;
+                cout << "25. View Recycling Stats" << endl;
+                cout << "26. Manage Inventory Alerts" << endl;
+                cout << "27. Blockchain Warranty Management" << endl;
+                cout << "28. Export Data to Text" << endl;
+                cout << "29. Import Data from Text" << endl;
+            }
+            cout << "30. View Receipts" << endl;
+            if (currentUser->username == "admin") {
+                cout << "31. Diagnose Device Cart" << endl;
+                cout << "32. Operation Stats" << endl;
+                cout << (tracingEnabled.load() ? "33. Stop Trace Timeline" : "33. Start Trace Timeline") << endl;
+            }
+            cout << "0. Logout" << endl;
+            cout << "Enter your choice: ";
+            {
+                TRACE_SPAN("waitForInput");
+                cin >> choice;
+            }
+            {
+                TRACE_SPAN("customerMenuAction", "choice", choice);
+                switch (choice) {
+                    case 1: buyItem(*currentUser); break;
+                    case 2: submitRepairRequest(); break;
+                    case 3: viewRepairRequests(); break;
+                    case 4: searchItems(); break;
+                    case 5: redeemLoyaltyPoints(*currentUser); break;
+                    case 6: offerTradeIn(*currentUser); break;
+                    case 7: conductVirtualRepairSession(); break;
+                    case 8: schedulePickupDelivery(); break;
+                    case 9: displayUserDashboard(*currentUser); break;
+                    case 10: 
+                        {
+                            string itemName;
+                            cout << "Enter item name for QR code: ";
+                            cin.ignore();
+                            getline(cin, itemName);
+                            generateQRCode(itemName);
+                        }
+                        break;
+                    case 11: simulateIoTDeviceRepair(); break;
+                    case 12: applyAugmentedRealityRepair(); break;
+                    case 13: offerSubscriptionService(); break;
+                    case 14: provideRepairEstimate(); break;
+                    case 15: offerRemoteDiagnostics(); break;
+                    case 16: gamifyLoyaltyProgram(*currentUser); break;
+                    case 17: if (currentUser->username == "admin") adminAddNewItem(); break;
+                    case 18: if (currentUser->username == "admin") adminAddStock(); break;
+                    case 19: if (currentUser->username == "admin") updateRepairStatus(); break;
+                    case 20: if (currentUser->username == "admin") displaySalesReport(); break;
+                    case 21: if (currentUser->username == "admin") displayInventoryStatus(); break;
+                    case 22: if (currentUser->username == "admin") displayPopularItems(); break;
+                    case 23: 
+                        if (currentUser->username == "admin") {
+                            displayRepairQueue();
+                            assignRepairTechnician();
+                        }
+                        break;
+                    case 24:
                         if (currentUser->username == "admin") {
-                            cout << "17. Add New Item" << endl;
-                            cout << "18. Add Stock" << endl;
-                            cout << "19. Update Repair Status" << endl;
-                            cout << "20. View Sales Report" << endl;
-                            cout << "21. View Inventory Status" << endl;
-                            cout << "22. View Popular Items" << endl;
-                            cout << "23. Manage Repair Queue" << endl;
-                            cout << "24. Manage 3D Print Jobs" << endl;
-                            cout << "25. View Recycling Stats" << endl;
-                            cout << "26. Manage Inventory Alerts" << endl;
-                            cout << "27. Blockchain Warranty Management" << endl;
+                            submit3DPrintJob();
+                            update3DPrintStatus();
                         }
-                        cout << "0. Logout" << endl;
-                        cout << "Enter your choice: ";
-                        cin >> choice;
-
-                        switch (choice) {
-                            case 1: buyItem(*currentUser); break;
-                            case 2: submitRepairRequest(); break;
-                            case 3: viewRepairRequests(); break;
-                            case 4: searchItems(); break;
-                            case 5: redeemLoyaltyPoints(*currentUser); break;
-                            case 6: offerTradeIn(*currentUser); break;
-                            case 7: conductVirtualRepairSession(); break;
-                            case 8: schedulePickupDelivery(); break;
-                            case 9: displayUserDashboard(*currentUser); break;
-                            case 10: 
-                                {
-                                    string itemName;
-                                    cout << "Enter item name for QR code: ";
-                                    cin.ignore();
-                                    getline(cin, itemName);
-                                    generateQRCode(itemName);
-                                }
-                                break;
-                            case 11: simulateIoTDeviceRepair(); break;
-                            case 12: applyAugmentedRealityRepair(); break;
-                            case 13: offerSubscriptionService(); break;
-                            case 14: provideRepairEstimate(); break;
-                            case 15: offerRemoteDiagnostics(); break;
-                            case 16: gamifyLoyaltyProgram(*currentUser); break;
-                            case 17: if (currentUser->username == "admin") adminAddNewItem(); break;
-                            case 18: if (currentUser->username == "admin") adminAddStock(); break;
-                            case 19: if (currentUser->username == "admin") updateRepairStatus(); break;
-                            case 20: if (currentUser->username == "admin") displaySalesReport(); break;
-                            case 21: if (currentUser->username == "admin") displayInventoryStatus(); break;
-                            case 22: if (currentUser->username == "admin") displayPopularItems(); break;
-                            case 23: 
-                                if (currentUser->username == "admin") {
-                                    displayRepairQueue();
-                                    assignRepairTechnician();
-                                }
-                                break;
-                            case 24:
-                                if (currentUser->username == "admin") {
-                                    submit3DPrintJob();
-                                    update3DPrintStatus();
-                                }
-                                break;
-                            case 25: if (currentUser->username == "admin") displayRecyclingStats(); break;
-                            case 26: if (currentUser->username == "admin") manageInventoryAlerts(); break;
-                            case 27: if (currentUser->username == "admin") implementBlockchainWarranty(); break;
-                            case 0: loggedIn = false; break;
-                            default: cout << "Invalid choice!" << endl; pause();
+                        break;
+                    case 25: if (currentUser->username == "admin") displayRecyclingStats(); break;
+                    case 26: if (currentUser->username == "admin") manageInventoryAlerts(); break;
+                    case 27: if (currentUser->username == "admin") implementBlockchainWarranty(); break;
+                    case 28: if (currentUser->username == "admin") adminExportData(); break;
+                    case 29:
+                        // Importing replaces the user table, so the session has to end
+                        if (currentUser->username == "admin" && adminImportData()) {
+                            loggedIn = false;
                         }
-                    }
+                        break;
+                    case 30: viewReceipts(*currentUser); break;
+                    case 31: if (currentUser->username == "admin") diagnoseDeviceCart(); break;
+                    case 32: if (currentUser->username == "admin") displayOperationStats(); break;
+                    case 33: if (currentUser->username == "admin") toggleTracing(); break;
+                    case 0: loggedIn = false; break;
+                    default: cout << "Invalid choice!" << endl; pause();
                 }
-                break;
-            case 3:
-                running = false;
-                break;
-            default:
-                cout << "Invalid choice!" << endl;
-                pause();
+            }
+            // Each completed action is durable before the next prompt
+            syncJournal();
+            maybeCompactJournal();
+            maybeDumpOperationStats();
+            flushTrace();
+            actionArena().reset();
         }
     }
 
+    mailQueue.stop(); // Deliver anything still queued
     saveDataToFile(); // Save data before exiting
+    closeJournal();
+    dumpOperationStats();
+    stopTracing();
     cout << "Thank you for using the Advanced T.I.P. Recycle and Repair Shop System!" << endl;
+    terminal.detach();
     return 0;
 }
+#endif